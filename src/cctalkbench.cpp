@@ -0,0 +1,197 @@
+/**
+ * @file cctalkbench.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Timing jitter benchmark, default scheduling against real-time mode
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * Usage: cctalkbench [-n count] [-c core] [-r priority] port:addr
+ *        cctalkbench [-n count] [-c core] [-r priority] -t periodUs
+ *
+ * With port:addr every sample is the request-to-reply time of a SimplePoll.
+ * With -t no device is needed, every sample is how late a sleep of periodUs wakes up.
+ * A pass under the default scheduler is always run; with -r a second pass runs in
+ * real-time mode (SCHED_FIFO, locked and prefaulted memory) for comparison.
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lib/cctalk/cctalk.h"
+#include "lib/cctalk/cctalkcommands.h"
+#include "lib/runtime/worker.h"
+#include "lib/runtime/realtime.h"
+
+typedef std::chrono::steady_clock Clock;
+
+/** @brief Result of one pass */
+struct Pass {
+    std::vector<uint32_t> samples;  // Micro seconds
+    int failures;
+};
+
+/**
+ * @brief Micro seconds between two time points
+ *
+ * @param start Start
+ * @param end End
+ * @return Micro seconds
+ */
+static uint32_t elapsedUs(const Clock::time_point &start, const Clock::time_point &end){
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+}
+
+/**
+ * @brief Measure SimplePoll round trips
+ *
+ * @param cct Connected bus
+ * @param address Device address
+ * @param pass Reference to pass, samples must be reserved
+ */
+static void runPoll(CCTalk &cct, const uint8_t address, Pass &pass){
+    CCTalkCommands::EmptyReply n_reply;
+    size_t n_count = pass.samples.capacity();
+    for(size_t n_index = 0; n_index < n_count; n_index++) {
+        Clock::time_point n_start = Clock::now();
+        int n_res = CCTalkCommands::request<CCTalk::Header::SimplePoll>(cct, address, n_reply);
+        Clock::time_point n_end = Clock::now();
+        if(n_res != 0) {
+            pass.failures++;
+            continue;
+        }
+        pass.samples.push_back(elapsedUs(n_start, n_end));
+    }
+}
+
+/**
+ * @brief Measure sleep overshoot
+ *
+ * @param periodUs Requested sleep
+ * @param pass Reference to pass, samples must be reserved
+ */
+static void runTimer(const int periodUs, Pass &pass){
+    size_t n_count = pass.samples.capacity();
+    for(size_t n_index = 0; n_index < n_count; n_index++) {
+        Clock::time_point n_start = Clock::now();
+        std::this_thread::sleep_for(std::chrono::microseconds(periodUs));
+        uint32_t n_us = elapsedUs(n_start, Clock::now());
+        pass.samples.push_back((n_us > (uint32_t)periodUs) ? n_us - (uint32_t)periodUs : 0);
+    }
+}
+
+/**
+ * @brief Get a percentile of sorted samples
+ *
+ * @param sorted Sorted samples
+ * @param permille Percentile in 1/10 percent
+ * @return Value
+ */
+static uint32_t percentile(const std::vector<uint32_t> &sorted, const int permille){
+    if(sorted.empty()) return 0;
+    size_t n_rank = (sorted.size() * permille + 999) / 1000;
+    return sorted[(n_rank > 0) ? n_rank - 1 : 0];
+}
+
+/**
+ * @brief Print the distribution of a pass
+ *
+ * @param name Pass name
+ * @param pass Pass
+ */
+static void report(const char *name, Pass &pass){
+    std::vector<uint32_t> &n_sorted = pass.samples;
+    std::sort(n_sorted.begin(), n_sorted.end());
+    if(n_sorted.empty()) {
+        std::printf("%-10s no samples, %d failures\n", name, pass.failures);
+        return;
+    }
+    std::printf("%-10s %8u %8u %8u %8u %8u %8u %8d\n", name, n_sorted.front(),
+                percentile(n_sorted, 500), percentile(n_sorted, 900), percentile(n_sorted, 990),
+                percentile(n_sorted, 999), n_sorted.back(), pass.failures);
+}
+
+int main(int argc, char *argv[])
+{
+    int n_count = 1000;
+    int n_core = -1;
+    int n_priority = 0;
+    int n_periodUs = 0;
+    std::string n_port;
+    int n_address = 0;
+
+    for(int n_arg = 1; n_arg < argc; n_arg++) {
+        if(strcmp(argv[n_arg], "-n") == 0 && n_arg + 1 < argc) {
+            n_count = atoi(argv[++n_arg]);
+        } else if(strcmp(argv[n_arg], "-c") == 0 && n_arg + 1 < argc) {
+            n_core = atoi(argv[++n_arg]);
+        } else if(strcmp(argv[n_arg], "-r") == 0 && n_arg + 1 < argc) {
+            n_priority = atoi(argv[++n_arg]);
+        } else if(strcmp(argv[n_arg], "-t") == 0 && n_arg + 1 < argc) {
+            n_periodUs = atoi(argv[++n_arg]);
+        } else {
+            std::string n_spec(argv[n_arg]);
+            size_t n_pos = n_spec.rfind(':');
+            if(n_pos == std::string::npos || n_pos == 0) break;
+            n_port = n_spec.substr(0, n_pos);
+            n_address = atoi(n_spec.substr(n_pos + 1).c_str());
+        }
+    }
+    if(n_count <= 0 || (n_periodUs <= 0 && (n_port.empty() || n_address < 1 || n_address > 255))) {
+        std::printf("Usage: %s [-n count] [-c core] [-r priority] port:addr\n", argv[0]);
+        std::printf("       %s [-n count] [-c core] [-r priority] -t periodUs\n", argv[0]);
+        return 1;
+    }
+
+    if(n_core >= 0 && Worker::pinCurrentThread(n_core) != 0) {
+        std::printf("Unable to pin to core %d\n", n_core);
+        return 1;
+    }
+
+    CCTalk n_cct(1);
+    if(n_periodUs <= 0 && n_cct.connect(n_port.c_str(), B9600) != 0) {
+        std::printf("Unable to open %s\n", n_port.c_str());
+        return 1;
+    }
+
+    Pass n_passes[2];
+    const char *n_names[2] = { "default", "realtime" };
+    int n_passCount = (n_priority > 0) ? 2 : 1;
+
+    for(int n_index = 0; n_index < n_passCount; n_index++) {
+        Pass &n_pass = n_passes[n_index];
+        n_pass.samples.reserve(n_count);
+        n_pass.failures = 0;
+
+        if(n_index == 1) {
+            if(RealTime::lockMemory() != 0) std::printf("Unable to lock memory\n");
+            if(RealTime::enterThread(n_priority) != 0) {
+                std::printf("Unable to set SCHED_FIFO priority %d (needs CAP_SYS_NICE)\n", n_priority);
+                n_passCount = 1;
+                break;
+            }
+            RealTime::prefault(n_pass.samples.data(), n_pass.samples.capacity() * sizeof(uint32_t));
+        }
+
+        if(n_periodUs > 0) runTimer(n_periodUs, n_pass);
+        else runPoll(n_cct, (uint8_t)n_address, n_pass);
+
+        if(n_index == 1) {
+            RealTime::setThreadPriority(0);
+            RealTime::unlockMemory();
+        }
+    }
+    if(n_periodUs <= 0) n_cct.disconnect();
+
+    std::printf("%s, %d samples, micro seconds\n",
+                (n_periodUs > 0) ? "Sleep overshoot" : "SimplePoll round trip", n_count);
+    std::printf("%-10s %8s %8s %8s %8s %8s %8s %8s\n", "mode", "min", "p50", "p90", "p99", "p99.9", "max", "failed");
+    for(int n_index = 0; n_index < n_passCount; n_index++) report(n_names[n_index], n_passes[n_index]);
+    return 0;
+}
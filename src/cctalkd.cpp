@@ -0,0 +1,423 @@
+/**
+ * @file cctalkd.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief CCTalk polling daemon, exports device state and events through shared memory
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * Usage: cctalkd [-n /shmname] [-i fastPollMs] [-r priority] port:addr[,addr...][@core] [port:addr...]
+ *   e.g. cctalkd -n /cctalk -r 40 /dev/ttyUSB1:2@1 /dev/ttyUSB2:2,3@2
+ *
+ * Every bus is served by its own worker thread, optionally pinned to a core. Workers
+ * hand device updates and events to the main thread through lock-free queues and
+ * wake it when there is something to write. The main thread is the only writer of
+ * the shared memory. With -r the process memory is
+ * locked and the bus workers run SCHED_FIFO at the given priority.
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lib/cctalk/cctalk.h"
+#include "lib/cctalk/cctalkshm.h"
+#include "lib/cctalk/cctalkscheduler.h"
+#include "lib/runtime/worker.h"
+#include "lib/runtime/realtime.h"
+#include "lib/runtime/spscqueue.h"
+
+/** @brief First reconnect delay */
+static const int MinBackoffMs = 100;
+/** @brief Max reconnect delay */
+static const int MaxBackoffMs = 5000;
+/** @brief Longest sleep of a bus worker */
+static const int MaxSleepMs = 100;
+/** @brief Longest wait of the main thread for updates, bounds the reaction to a stop signal */
+static const int MaxWaitMs = 100;
+
+/** @brief Device polled on a bus */
+struct Device {
+    uint8_t address;
+    CCTalk::EventStack eventStack;
+    bool online;
+};
+
+/** @brief Update handed from a bus worker to the shared memory writer */
+struct Update {
+    enum Kind : uint8_t {
+        DeviceState,
+        Event,
+        BusOffline
+    };
+    Kind kind;
+    uint8_t address;
+    uint8_t online;
+    uint8_t lastEventId;
+    uint8_t type;
+    uint8_t value;
+    uint32_t lostEvents;
+};
+
+/** @brief A serial port with one or more devices, owned by one worker */
+struct Bus {
+    std::string port;
+    uint8_t index;
+    int core;                   // Core of the worker, -1 for any
+    CCTalk *cct;                // Lives in the worker arena
+    std::vector<Device> devices;
+    CCTalkPollScheduler scheduler;
+    int failures;               // Polls without reply in a row
+    bool connected;
+    int backoffMs;
+    std::chrono::steady_clock::time_point nextAttempt;
+    SpscQueue<Update, 1024> updates;
+    Worker worker;
+};
+
+static volatile sig_atomic_t s_running = 1;
+
+/** @brief Wakes the main thread when a worker posted updates */
+static std::mutex s_wakeMutex;
+static std::condition_variable s_wake;
+static std::atomic<bool> s_pending(false);
+
+static void onSignal(int signal){
+    s_running = 0;
+}
+
+/**
+ * @brief Parse "port:addr[,addr...][@core]"
+ *
+ * @param arg Argument
+ * @param bus Reference to bus
+ * @return Success
+ */
+static int parseBus(const std::string &arg, Bus &bus){
+    std::string n_spec(arg);
+    bus.core = -1;
+    size_t n_at = n_spec.rfind('@');
+    if(n_at != std::string::npos) {
+        bus.core = atoi(n_spec.substr(n_at + 1).c_str());
+        if(bus.core < 0 || bus.core >= Worker::getCoreCount()) return -1;
+        n_spec.erase(n_at);
+    }
+
+    size_t n_pos = n_spec.rfind(':');
+    if(n_pos == std::string::npos || n_pos == 0) return -1;
+    bus.port = n_spec.substr(0, n_pos);
+
+    std::string n_list = n_spec.substr(n_pos + 1);
+    size_t n_start = 0;
+    while(n_start < n_list.size()) {
+        size_t n_end = n_list.find(',', n_start);
+        if(n_end == std::string::npos) n_end = n_list.size();
+        int n_addr = atoi(n_list.substr(n_start, n_end - n_start).c_str());
+        if(n_addr < 1 || n_addr > 255) return -1;
+        Device n_device;
+        n_device.address = (uint8_t)n_addr;
+        n_device.online = false;
+        bus.devices.push_back(n_device);
+        n_start = n_end + 1;
+    }
+    return bus.devices.empty() ? -1 : 0;
+}
+
+/**
+ * @brief Hand an update to the main thread, waits while the queue is full
+ *
+ * @param bus Bus
+ * @param update Update
+ */
+static void post(Bus &bus, const Update &update){
+    while(!bus.updates.push(update)) {
+        if(bus.worker.isStopping()) return;
+        std::this_thread::yield();
+    }
+    // Only the first update after a drain takes the lock
+    if(!s_pending.exchange(true)) {
+        std::lock_guard<std::mutex> n_lock(s_wakeMutex);
+        s_wake.notify_one();
+    }
+}
+
+/**
+ * @brief Post the state of a device
+ *
+ * @param bus Bus
+ * @param device Device
+ * @param online Device answers
+ */
+static void postDevice(Bus &bus, const Device &device, const bool online){
+    Update n_update = Update();
+    n_update.kind = Update::DeviceState;
+    n_update.address = device.address;
+    n_update.online = online ? 1 : 0;
+    n_update.lastEventId = device.eventStack.lastEventId;
+    n_update.lostEvents = device.eventStack.totalLost;
+    post(bus, n_update);
+}
+
+/**
+ * @brief Drop the connection and schedule a reconnect with exponential backoff
+ *
+ * @param bus Bus
+ */
+static void dropBus(Bus &bus){
+    if(bus.connected) {
+        bus.cct->disconnect();
+        std::printf("%s: disconnected\n", bus.port.c_str());
+    }
+    bus.connected = false;
+    // The event stacks are kept, events that happen while offline are reported
+    // (or counted as lost) on the first read after the reconnect
+    for(Device &n_device : bus.devices) n_device.online = false;
+    Update n_update = Update();
+    n_update.kind = Update::BusOffline;
+    post(bus, n_update);
+
+    bus.nextAttempt = std::chrono::steady_clock::now() + std::chrono::milliseconds(bus.backoffMs);
+    bus.backoffMs = (bus.backoffMs * 2 > MaxBackoffMs) ? MaxBackoffMs : bus.backoffMs * 2;
+}
+
+/**
+ * @brief Poll the event buffer of one device
+ *
+ * @param bus Bus
+ * @param device Device
+ * @return Success
+ */
+static int pollDevice(Bus &bus, Device &device){
+    int n_diff = bus.cct->getEventStack(device.address, device.eventStack);
+    if(n_diff < 0) {
+        if(device.online) postDevice(bus, device, false);
+        device.online = false;
+        bus.scheduler.failed(device.address);
+        return -1;
+    }
+    bus.scheduler.update(device.address, n_diff, device.eventStack.lost);
+    if(device.eventStack.lost > 0)
+        std::printf("%s: device %d lost %d events\n", bus.port.c_str(), device.address, device.eventStack.lost);
+
+    // The device reports the newest event first, publish oldest first
+    std::vector<CCTalk::CCT_Event> &n_events = device.eventStack.events;
+    int n_first = (int)n_events.size() - n_diff;
+    if(n_first < 0) n_first = 0;
+    for(int n_pos = (int)n_events.size() - 1; n_pos >= n_first; n_pos--) {
+        Update n_update = Update();
+        n_update.kind = Update::Event;
+        n_update.address = device.address;
+        n_update.type = n_events[n_pos].event_Type;
+        n_update.value = n_events[n_pos].event_Value;
+        post(bus, n_update);
+    }
+    n_events.clear();
+
+    if(!device.online || n_diff > 0 || device.eventStack.lost > 0) postDevice(bus, device, true);
+    device.online = true;
+    return 0;
+}
+
+/**
+ * @brief Poll every device of a bus that is due
+ *
+ * @param bus Bus
+ * @return Milli seconds until the next device is due, -1 if no device answers
+ */
+static int serviceBus(Bus &bus){
+    while(true) {
+        uint8_t n_address = 0;
+        int n_wait = bus.scheduler.next(n_address);
+        if(n_wait != 0) return n_wait;
+
+        for(Device &n_device : bus.devices) {
+            if(n_device.address != n_address) continue;
+            if(pollDevice(bus, n_device) == 0) {
+                bus.failures = 0;
+            } else if(++bus.failures >= (int)bus.devices.size()) {
+                return -1;
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Worker task of a bus: (re)connect and poll
+ *
+ * @param worker Worker running the bus
+ * @param bus Bus
+ * @return Milli seconds until the next call, -1 to end the worker
+ */
+static int runBus(Worker &worker, Bus &bus){
+    if(bus.cct == nullptr) {
+        const int n_errors = worker.getErrors();
+        if(n_errors & Worker::PinFailed) std::printf("%s: unable to pin worker to core %d\n", bus.port.c_str(), bus.core);
+        if(n_errors & Worker::ArenaFailed) std::printf("%s: unable to reserve worker arena\n", bus.port.c_str());
+        if(n_errors & Worker::RealTimeFailed) std::printf("%s: no real-time priority, running with default scheduling\n", bus.port.c_str());
+
+        // The interface is allocated on the worker's own core. Its frame and
+        // package buffers are fixed size, so polling doesn't allocate.
+        bus.cct = worker.getArena().create<CCTalk>(1);
+        if(bus.cct == nullptr) {
+            std::printf("%s: unable to allocate interface\n", bus.port.c_str());
+            return -1;
+        }
+        for(Device &n_device : bus.devices) n_device.eventStack.events.reserve(CCTalkPollScheduler::EventBufferSize);
+    }
+
+    if(!bus.connected) {
+        int n_wait = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+                        bus.nextAttempt - std::chrono::steady_clock::now()).count();
+        if(n_wait > 0) return (n_wait < MaxSleepMs) ? n_wait : MaxSleepMs;
+        if(bus.cct->connect(bus.port.c_str(), B9600) != 0) {
+            dropBus(bus);
+            return MinBackoffMs;
+        }
+        bus.connected = true;
+        bus.failures = 0;
+        std::printf("%s: connected\n", bus.port.c_str());
+        for(Device &n_device : bus.devices) bus.scheduler.queryPollPriority(*bus.cct, n_device.address);
+    }
+
+    int n_wait = serviceBus(bus);
+    if(n_wait < 0) {
+        dropBus(bus);
+        return 0;
+    }
+    bus.backoffMs = MinBackoffMs;
+    return (n_wait < MaxSleepMs) ? n_wait : MaxSleepMs;
+}
+
+/**
+ * @brief Worker cleanup of a bus
+ *
+ * @param bus Bus
+ */
+static void finishBus(Bus &bus){
+    if(bus.cct == nullptr) return;
+    if(bus.connected) bus.cct->disconnect();
+    bus.connected = false;
+    Arena::destroy(bus.cct);
+    bus.cct = nullptr;
+}
+
+/**
+ * @brief Write the queued updates of a bus to shared memory
+ *
+ * @param bus Bus
+ * @param shm Shared memory export
+ * @return Number of updates written
+ */
+static int drainBus(Bus &bus, CCTalkSharedExport &shm){
+    int n_count = 0;
+    Update n_update;
+    while(bus.updates.pop(n_update)) {
+        switch (n_update.kind)
+        {
+        case Update::DeviceState:
+            shm.setDevice(bus.index, n_update.address, n_update.online != 0, n_update.lastEventId, n_update.lostEvents);
+            break;
+        case Update::Event:
+            shm.publishEvent(bus.index, n_update.address, n_update.type, n_update.value);
+            break;
+        case Update::BusOffline:
+            shm.setBusOffline(bus.index);
+            break;
+        }
+        n_count++;
+    }
+    return n_count;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string n_shmName("/cctalk");
+    int n_pollMs = 20;
+    int n_priority = 0;
+    std::vector<std::unique_ptr<Bus>> n_buses;
+
+    for(int n_arg = 1; n_arg < argc; n_arg++) {
+        if(strcmp(argv[n_arg], "-n") == 0 && n_arg + 1 < argc) {
+            n_shmName = argv[++n_arg];
+        } else if(strcmp(argv[n_arg], "-i") == 0 && n_arg + 1 < argc) {
+            n_pollMs = atoi(argv[++n_arg]);
+        } else if(strcmp(argv[n_arg], "-r") == 0 && n_arg + 1 < argc) {
+            n_priority = atoi(argv[++n_arg]);
+        } else {
+            std::unique_ptr<Bus> n_bus(new Bus());
+            if(parseBus(argv[n_arg], *n_bus) != 0) {
+                std::printf("Invalid bus '%s', expected port:addr[,addr...][@core]\n", argv[n_arg]);
+                return 1;
+            }
+            n_buses.push_back(std::move(n_bus));
+        }
+    }
+    if(n_buses.empty() || n_buses.size() > 255) {
+        std::printf("Usage: %s [-n /shmname] [-i fastPollMs] [-r priority] port:addr[,addr...][@core] ...\n", argv[0]);
+        return 1;
+    }
+
+    CCTalkSharedExport n_shm;
+    if(n_shm.create(n_shmName) != 0) {
+        std::printf("Unable to create shared memory %s\n", n_shmName.c_str());
+        return 1;
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    // Workers print status lines, each is flushed as it is written
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+
+    // Locked before the workers start, their stacks and arenas are locked as they are faulted in
+    if(n_priority > 0 && RealTime::lockMemory() != 0) {
+        std::printf("Unable to lock memory, page faults may delay bus timing\n");
+    }
+
+    for(size_t n_index = 0; n_index < n_buses.size(); n_index++) {
+        Bus &n_bus = *n_buses[n_index];
+        n_bus.index = (uint8_t)n_index;
+        n_bus.cct = nullptr;
+        n_bus.connected = false;
+        n_bus.failures = 0;
+        n_bus.backoffMs = MinBackoffMs;
+        n_bus.nextAttempt = std::chrono::steady_clock::now();
+        n_bus.scheduler.setFastInterval(n_pollMs);
+        for(Device &n_device : n_bus.devices) {
+            n_bus.scheduler.addDevice(n_device.address);
+            n_shm.setDevice(n_bus.index, n_device.address, false, 0);
+        }
+        n_bus.worker.setRealTime(n_priority);
+        n_bus.worker.start(n_bus.core,
+                           [&n_bus](Worker &worker){ return runBus(worker, n_bus); },
+                           [&n_bus](Worker &worker){ finishBus(n_bus); });
+    }
+    std::printf("Exporting %d bus(es) to %s\n", (int)n_buses.size(), n_shmName.c_str());
+
+    while(s_running) {
+        {
+            std::unique_lock<std::mutex> n_lock(s_wakeMutex);
+            s_wake.wait_for(n_lock, std::chrono::milliseconds(MaxWaitMs), []{ return s_pending.load(); });
+        }
+        // Cleared before draining, updates posted meanwhile wake the next wait
+        s_pending = false;
+        for(std::unique_ptr<Bus> &n_bus : n_buses) drainBus(*n_bus, n_shm);
+    }
+
+    for(std::unique_ptr<Bus> &n_bus : n_buses) {
+        n_bus->worker.stop();
+        drainBus(*n_bus, n_shm);
+    }
+    n_shm.close();
+    std::printf("Stopped\n");
+    return 0;
+}
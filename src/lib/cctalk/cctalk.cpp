@@ -10,10 +10,17 @@
  */
 
 #include "cctalk.h"
+#include "cctalkcommands.h"
 #include <iostream>
 #include <unistd.h>
 #include <inttypes.h>
-CCTalk::CCTalk(const uint8_t id) : _id(id){ }
+#include <chrono>
+#include <string.h>
+
+CCTalk::CCTalk(const uint8_t id) : _id(id), _lastHeader(0), _wireLen(0){
+    _parser.setLocalAddress(id);
+    memset(_resets, 0, sizeof(_resets));
+}
 
 CCTalk::~CCTalk(){
     disconnect();
@@ -29,102 +36,217 @@ uint8_t CCTalk::calcCrc(const CCTalkPackage &package){
 }
 
 int CCTalk::transmitPackage(CCTalkPackage &package){
+    return transmitFrame(package.toBytearray(), package.getMessageSize());
+}
 
-    uint8_t* n_bffr = package.toBytearray();
-    int n_size = sizeof(n_bffr) + 1;
-    int n_written = transmit(n_bffr, n_size);
-
-    if(n_size != n_written) return -1;
+int CCTalk::retransmit(){
+    if(_wireLen == 0) return -1;
+    // Anything still buffered, here or in the driver, belongs to an earlier
+    // transaction. A late reply left there would be taken for this one's.
+    _parser.reset();
+    if(flushInput() != 0) return -1;
+    _parser.expectEcho(_wire, _wireLen);
+    _parser.setReplyLimit(CCTalkCommands::replyLimit(_wire[3]));
+
+    int n_written = transmitAll(_wire, _wireLen);
+    if(n_written != _wireLen) return -1;
     return 0;
 }
 
+int CCTalk::fillParser(const bool wait){
+    uint8_t n_bffr[64];
+    int n_want = available();
+    if(n_want < 0) return -1;
+    if(n_want == 0) {
+        if(!wait) return 0;
+        n_want = 1;
+    }
+    if(n_want > (int)sizeof(n_bffr)) n_want = sizeof(n_bffr);
+    if(n_want > _parser.space()) n_want = _parser.space();
+
+    int n_read = receive(n_bffr, n_want);
+    if(n_read < 0) return -1;
+    return _parser.push(n_bffr, n_read);
+}
+
 int CCTalk::receivePackage(CCTalkPackage &package){
-    
-    uint8_t n_head_bffr[4];
-    int n_read = receive(n_head_bffr, 4);
-    if(n_read != 4) return -1;
-    package.receiverID = n_head_bffr[0];
-    package.length = n_head_bffr[1];
-    package.senderID = n_head_bffr[2];
-    package.header = n_head_bffr[3];
-
-
-    if(package.length > 0) {
-        package.data = new uint8_t[package.length];
-        n_read = receive(package.data, package.length);
-        if(n_read != package.length) return -1;
+    return receiveReply(package, _retry.getTimeout(_lastHeader));
+}
+
+int CCTalk::receiveReply(CCTalkPackage &package, const int timeoutMs){
+    const auto n_end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    uint8_t n_frame[MaxFrameSize];
+
+    while(true) {
+        int n_len = _parser.next(n_frame);
+        if(n_len > 0) return decodeFrame(n_frame, n_len, package);
+
+        int n_left = (int)std::chrono::duration_cast<std::chrono::milliseconds>(n_end - std::chrono::steady_clock::now()).count();
+        if(n_left <= 0) return -1;
+        if(waitReadable(n_left) <= 0) return -1;
+        if(fillParser(false) < 0) return -1;
+    }
+}
+
+int CCTalk::exchange(const uint8_t *frame, const int len, CCTalkPackage &reply){
+    const uint8_t n_header = frame[3];
+    const int n_attempts = _retry.getAttempts(n_header);
+    int n_res = -1;
+
+    if(transmitFrame(frame, len) != 0) return -1;
+    for(int n_attempt = 0; n_attempt < n_attempts; n_attempt++) {
+        // A retry is the same request
+        if(n_attempt > 0 && retransmit() != 0) return -1;
+        const auto n_start = std::chrono::steady_clock::now();
+
+        // Timeouts and corrupted replies are worth a retransmit
+        int n_rx = receiveReply(reply, _retry.getTimeout(n_header));
+        if(n_rx != 0) {
+            n_res = -1;
+            continue;
+        }
+        _retry.addSample(n_header, (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                                        std::chrono::steady_clock::now() - n_start).count());
+
+        if(reply.header == (uint8_t)Header::NAKmessage) return -2;
+        if(reply.header == (uint8_t)Header::BUSYmessage) {
+            n_res = -3;
+            usleep(_retry.getBusyBackoff(n_attempt) * 1000);
+            continue;
+        }
+        return 0;
     }
-    
-    n_read = receive(&package.crc, 1);
-    if(n_read != 1) return -1;
+    return n_res;
+}
+
+int CCTalk::decodeFrame(const uint8_t *frame, const int len, CCTalkPackage &package){
+    package.receiverID = frame[0];
+    package.length = frame[1];
+    package.senderID = frame[2];
+    package.header = frame[3];
+
+    memcpy(package.data, &frame[4], package.length);
+    package.crc = frame[len - 1];
 
     uint8_t n_crc = calcCrc(package);
-    if(n_crc != package.crc) return -1;
+    if(n_crc != package.crc) return -2;
     return 0;
 }
 
 int CCTalk::transmitPackageWithReply(CCTalkPackage &transmit, CCTalkPackage &reply){
+    int n_size = transmit.getMessageSize();
+    if(n_size > MaxFrameSize) return -1;
+    uint8_t n_frame[MaxFrameSize];
+    memcpy(n_frame, transmit.toBytearray(), n_size);
+    return exchange(n_frame, n_size, reply);
+}
 
-    if(transmitPackage(transmit) != 0) return -1;
-    usleep(100);
-    if(receivePackage(reply) != 0) return -1;
-    return 0;
+int CCTalk::transmitFrame(const uint8_t *frame, const int len){
+    if(len < 5 || len > MaxFrameSize) return -1;
+    memcpy(_wire, frame, len);
+    _wireLen = len;
+    _lastHeader = frame[3];
+    return retransmit();
 }
 
-int CCTalk::getEventStack(const uint8_t receiverID, EventStack &eventStack){
-    CCTalkPackage n_sendPack;
-    CCTalkPackage n_recvPack;
+int CCTalk::transmitFrameWithReply(const uint8_t *frame, const int len, CCTalkPackage &reply){
+    if(len < 5) return -1;
+    return exchange(frame, len, reply);
+}
 
-    static bool n_firstEvent = true;
+int CCTalk::probeFrame(const uint8_t *frame, const int len, CCTalkPackage &reply, const int timeoutMs){
+    if(transmitFrame(frame, len) != 0) return -1;
+    return (receiveReply(reply, timeoutMs) == 0) ? 0 : -1;
+}
 
+int CCTalk::sendCommand(const uint8_t receiverID, const Header header, const uint8_t *data,
+                        const uint8_t length, CCTalkPackage &reply){
+    CCTalkPackage n_sendPack;
     n_sendPack.senderID = _id;
-    n_sendPack.length = 0;
+    n_sendPack.length = length;
     n_sendPack.receiverID = receiverID;
-    n_sendPack.header = (uint8_t)Header::ReadBuffCreditOrErr;
+    n_sendPack.header = (uint8_t)header;
+    if(length > 0) memcpy(n_sendPack.data, data, length);
     n_sendPack.crc = calcCrc(n_sendPack);
-    
-    int n_res = transmitPackageWithReply(n_sendPack, n_recvPack);
-    if(n_res != 0)
-        return -1;
-    
 
-    if(n_recvPack.header != (uint8_t)Header::ReturnMessage)
+    int n_res = transmitPackageWithReply(n_sendPack, reply);
+    if(n_res != 0) return n_res;
+    if(reply.header != (uint8_t)Header::ReturnMessage) return -1;
+    return 0;
+}
+
+int CCTalk::receiveWindow(uint8_t *buffer, const int maxLen, const int windowMs){
+    const auto n_end = std::chrono::steady_clock::now() + std::chrono::milliseconds(windowMs);
+    int n_count = 0;
+
+    while(n_count < maxLen) {
+        int n_left = (int)std::chrono::duration_cast<std::chrono::milliseconds>(n_end - std::chrono::steady_clock::now()).count();
+        if(n_left <= 0) break;
+        int n_res = waitReadable(n_left);
+        if(n_res < 0) return -1;
+        if(n_res == 0) break;
+
+        int n_avail = available();
+        if(n_avail <= 0) continue;
+        if(n_avail > maxLen - n_count) n_avail = maxLen - n_count;
+        int n_read = receive(buffer, n_avail, n_count);
+        if(n_read < 0) return -1;
+        n_count += n_read;
+    }
+    return n_count;
+}
+
+int CCTalk::beginTransaction(CCTalkPackage &transmit){
+    return transmitPackage(transmit);
+}
+
+int CCTalk::serviceTransaction(CCTalkPackage &reply){
+    uint8_t n_frame[MaxFrameSize];
+    while(true) {
+        int n_len = _parser.next(n_frame);
+        if(n_len > 0) return (decodeFrame(n_frame, n_len, reply) == 0) ? 1 : -1;
+
+        int n_res = fillParser(false);
+        if(n_res < 0) return -1;
+        if(n_res == 0) return 0;
+    }
+}
+
+int CCTalk::getEventStack(const uint8_t receiverID, EventStack &eventStack){
+    CCTalkPackage n_recvPack;
+
+    const std::array<uint8_t, 5> n_frame = CCTalkCommands::encodeFrame<Header::ReadBuffCreditOrErr>(receiverID, _id);
+    if(transmitFrameWithReply(n_frame.data(), (int)n_frame.size(), n_recvPack) != 0)
+        return -1;
+    if(n_recvPack.header != (uint8_t)Header::ReturnMessage || n_recvPack.length == 0)
         return -1;
-    
-
-    if(n_recvPack.length == 0) 
-        return -1;        
-
-    uint8_t n_eventID = n_recvPack.data[0];
-    int diff = 0;
-    if(n_eventID != eventStack.lastEventId) {
-        
-        if(eventStack.lastEventId == 0) {
-            eventStack.events.clear();
-            n_firstEvent = !n_firstEvent;
-        } else {
-            if(!n_firstEvent) {
-                if(eventStack.lastEventId > n_eventID)
-                    diff = (255 - eventStack.lastEventId) + n_eventID;
-                else
-                    diff = n_eventID - eventStack.lastEventId;
-                
-                if(diff > ((n_recvPack.length - 1) / 2)) {
-                    diff = (n_recvPack.length - 1) / 2;
-                }
-
-                int n_dataPos = 1;
-                for(int n_eventIndex = 0; n_eventIndex < diff; n_eventIndex++){
-                    CCT_Event n_event(n_recvPack.data[n_dataPos], n_recvPack.data[n_dataPos+1]);
-                    n_dataPos+=2;
-                    eventStack.events.push_back(n_event);
-                }
-            } else {
-                n_firstEvent = false;            
-            }
-        }
 
-        eventStack.lastEventId = n_eventID;
+    const uint8_t n_counter = n_recvPack.data[0];
+    eventStack.lost = 0;
+
+    // First read only takes over the counter, 0 means the device was reset.
+    // Count the reset once, the counter stays 0 until the first event.
+    if(n_counter == 0 && (!eventStack.synced || eventStack.lastEventId != 0)) _resets[receiverID]++;
+    if(!eventStack.synced || n_counter == 0) {
+        eventStack.synced = true;
+        eventStack.lastEventId = n_counter;
+        return 0;
+    }
+
+    // The counter runs 1..255 and skips 0 when it wraps, distances are modulo 255
+    int n_diff = (int)n_counter - (int)eventStack.lastEventId;
+    n_diff += (n_diff < 0) * 255;
+
+    const int n_buffered = (n_recvPack.length - 1) / 2;
+    const int n_lost = (n_diff > n_buffered) ? n_diff - n_buffered : 0;
+    n_diff -= n_lost;
+
+    for(int n_index = 0; n_index < n_diff; n_index++) {
+        eventStack.events.push_back(CCT_Event(n_recvPack.data[1 + n_index * 2], n_recvPack.data[2 + n_index * 2]));
     }
-    return diff;
+
+    eventStack.lastEventId = n_counter;
+    eventStack.lost = n_lost;
+    eventStack.totalLost += n_lost;
+    return n_diff;
 }
@@ -14,6 +14,8 @@
 #include "../uart/serial.h"
 #include <vector>
 #include "cctalkpackage.h"
+#include "cctalkparser.h"
+#include "cctalkretry.h"
 
 class CCTalk : public Serial {
 
@@ -183,9 +185,12 @@ class CCTalk : public Serial {
     /** @brief CCTalk event stack object for storing data from ReadBuffCreditOrErr */
     class EventStack{
         public:
-        EventStack() : lastEventId(0){}
-        uint8_t lastEventId;    // Last marked event id (if 0 then the havent had any errors)
-        std::vector<CCT_Event> events;  // Event object list
+        EventStack() : lastEventId(0), synced(false), lost(0), totalLost(0){}
+        uint8_t lastEventId;    // Last event counter read (0 after a device reset)
+        bool synced;            // Counter has been read once, later reads report events
+        int lost;               // Events that overflowed the device buffer in the last read
+        uint32_t totalLost;     // Lost events since the stack was created
+        std::vector<CCT_Event> events;  // Event object list, newest event of each read first
     };
 
 
@@ -199,11 +204,13 @@ class CCTalk : public Serial {
     ~CCTalk();
 
     /**
-     * @brief Get the Event Stack object from device
+     * @brief Get the Event Stack object from device.
+     * The device buffers 5 events; if more happened since the last read the
+     * surplus is counted in eventStack.lost instead of being dropped silently.
      * 
      * @param receiverID Id the device that should respond transmission
      * @param eventStack Refrence to the eventStack object
-     * @return Result 
+     * @return Number of new events added, -1 on error
      */
     int getEventStack(const uint8_t receiverID, EventStack &eventStack);
 
@@ -232,6 +239,87 @@ class CCTalk : public Serial {
      */
     int transmitPackageWithReply(CCTalkPackage &transmit, CCTalkPackage &reply);
 
+    /**
+     * @brief Transmit a pre-encoded frame
+     * 
+     * @param frame Frame bytes including checksum
+     * @param len Number of bytes
+     * @return Result
+     */
+    int transmitFrame(const uint8_t *frame, const int len);
+
+    /**
+     * @brief Transmit the last frame again as the same bytes.
+     * Used for retries.
+     * 
+     * @return Result
+     */
+    int retransmit();
+
+    /**
+     * @brief Transmit a pre-encoded frame and receive reply
+     * 
+     * @param frame Frame bytes including checksum
+     * @param len Number of bytes
+     * @param reply Reference to message object to place received data in
+     * @return Result
+     */
+    int transmitFrameWithReply(const uint8_t *frame, const int len, CCTalkPackage &reply);
+
+    /**
+     * @brief Transmit a pre-encoded frame once and wait a short time for the reply.
+     * No retries and no retry policy samples, used to check if an address answers at all.
+     * 
+     * @param frame Frame bytes including checksum
+     * @param len Number of bytes
+     * @param reply Reference to message object to place received data in
+     * @param timeoutMs Max time to wait in milli seconds
+     * @return Result, -1 on timeout or a corrupted reply
+     */
+    int probeFrame(const uint8_t *frame, const int len, CCTalkPackage &reply, const int timeoutMs);
+
+    /**
+     * @brief Build, transmit and receive reply for a command
+     * 
+     * @param receiverID Id of the device that should respond
+     * @param header Command header
+     * @param data Pointer to request data (may be nullptr when length is 0)
+     * @param length Number of data bytes
+     * @param reply Reference to message object to place received data in
+     * @return Result, -1 if no valid reply or the reply isn't a ReturnMessage,
+     * -2 if the device answered NAK and -3 if it stayed BUSY
+     */
+    int sendCommand(const uint8_t receiverID, const Header header, const uint8_t *data,
+                    const uint8_t length, CCTalkPackage &reply);
+
+    /**
+     * @brief Collect all bytes arriving within a time window.
+     * Used for the unframed, timed replies of AddressPoll and AddressClash
+     * 
+     * @param buffer Pointer to input buffer
+     * @param maxLen Size of the buffer
+     * @param windowMs Length of the window in milli seconds
+     * @return Number of bytes received or -1 on error
+     */
+    int receiveWindow(uint8_t *buffer, const int maxLen, const int windowMs);
+
+    /**
+     * @brief Transmit message without waiting for the reply.
+     * The reply is collected with serviceTransaction()
+     * 
+     * @param transmit Message object to transmit
+     * @return Result
+     */
+    int beginTransaction(CCTalkPackage &transmit);
+
+    /**
+     * @brief Collect reply bytes already received, never blocks
+     * 
+     * @param reply Reference to message object to place received data in
+     * @return 1 when the reply is complete, 0 while pending and -1 on error
+     */
+    int serviceTransaction(CCTalkPackage &reply);
+
     /**
      * @brief Calculate CRC value
      * 
@@ -240,8 +328,85 @@ class CCTalk : public Serial {
      */
     uint8_t calcCrc(const CCTalkPackage &package);
 
+    /**
+     * @brief Get the CCTalk ID of this object
+     * 
+     * @return CCTalk ID
+     */
+    uint8_t getId() const { return _id; }
+
+    /**
+     * @brief Get the retry policy used by the request/reply functions
+     * 
+     * @return Retry policy
+     */
+    CCTalkRetryPolicy &getRetryPolicy() { return _retry; }
+
+    /**
+     * @brief Get the number of device resets getEventStack() has seen on an address.
+     * Caches of device data compare it with the value they were filled at.
+     * 
+     * @param address Device address
+     * @return Reset count
+     */
+    uint32_t getResetCount(const uint8_t address) const { return _resets[address]; }
+
+    /**
+     * @brief Get the number of received bytes dropped while resynchronizing
+     * 
+     * @return Byte count
+     */
+    uint32_t getDiscardedBytes() const { return _parser.getDiscarded(); }
+
+    /** @brief Largest possible ccTalk frame (255 data bytes + 5 bytes framing) */
+    static const int MaxFrameSize = CCTalkParser::MaxFrameSize;
+
+    private:
+    /**
+     * @brief Wait for a reply
+     * 
+     * @param package Reference to message object to place received data in
+     * @param timeoutMs Max time to wait in milli seconds
+     * @return Result, -1 on timeout, -2 on checksum error
+     */
+    int receiveReply(CCTalkPackage &package, const int timeoutMs);
+
+    /**
+     * @brief Send a frame and wait for the reply, retrying as the retry policy allows
+     * 
+     * @param frame Frame bytes including checksum
+     * @param len Number of bytes
+     * @param reply Reference to message object to place received data in
+     * @return Result, -1 on timeout, -2 on NAK and -3 if the device stayed BUSY
+     */
+    int exchange(const uint8_t *frame, const int len, CCTalkPackage &reply);
+
+    /**
+     * @brief Move received bytes to the parser
+     * 
+     * @param wait Block until at least one byte arrives or the read times out
+     * @return Number of bytes moved, -1 on error
+     */
+    int fillParser(const bool wait);
+
+    /**
+     * @brief Place a complete received frame in a package object
+     * 
+     * @param frame Frame bytes
+     * @param len Number of bytes in the frame
+     * @param package Reference to message object to place received data in
+     * @return Result, -2 on checksum error
+     */
+    int decodeFrame(const uint8_t *frame, const int len, CCTalkPackage &package);
+
     private:
     const uint8_t _id;
+    CCTalkParser _parser;
+    CCTalkRetryPolicy _retry;
+    uint8_t _lastHeader;
+    uint8_t _wire[MaxFrameSize];    // Last frame as sent, for retransmit()
+    int _wireLen;
+    uint32_t _resets[256];          // Device resets seen per address
 
     protected:
 };
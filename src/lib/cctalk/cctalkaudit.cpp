@@ -0,0 +1,160 @@
+/**
+ * @file cctalkaudit.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Incremental CCTalk audit counter collection with delta records
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include "cctalkaudit.h"
+#include "cctalkcommands.h"
+
+/** @brief The counters are 24 bit and wrap */
+static const uint32_t CounterWrapMask = 0xFFFFFF;
+
+CCTalkAudit::CCTalkAudit(CCTalk &cct) : _cct(cct), _current(0), _interval(1000),
+                                         _nextRead(std::chrono::steady_clock::now()){ }
+
+CCTalkAudit::~CCTalkAudit(){ }
+
+int CCTalkAudit::addDevice(const uint8_t address, const bool auditBlock){
+    for(const Device &n_device : _devices) {
+        if(n_device.address == address) return -1;
+    }
+    Device n_device;
+    n_device.address = address;
+    n_device.hasAuditBlock = auditBlock;
+    n_device.hasSnapshot = false;
+    n_device.step = 0;
+    n_device.mask = 0;
+    n_device.known = 0;
+    for(int n_index = 0; n_index < CounterCount; n_index++) n_device.snapshot[n_index] = n_device.current[n_index] = 0;
+    _devices.push_back(n_device);
+    return 0;
+}
+
+void CCTalkAudit::setInterval(const int intervalMs){
+    _interval = std::chrono::milliseconds(intervalMs);
+}
+
+int CCTalkAudit::readStep(Device &device){
+    if(device.step == CounterCount) {
+        CCTalkPackage n_recvPack;
+        if(_cct.sendCommand(device.address, CCTalk::Header::RequestAuditInfoBlock, nullptr, 0, n_recvPack) != 0) return -1;
+        std::vector<uint8_t> n_block(n_recvPack.data, n_recvPack.data + n_recvPack.length);
+        if(n_block != device.auditBlock) {
+            device.auditBlock.swap(n_block);
+            device.mask |= AuditBlock;
+        }
+        return 0;
+    }
+
+    CCTalkCommands::Counter24Reply n_reply;
+    int n_res = -1;
+    switch (device.step)
+    {
+    case Insertion: n_res = CCTalkCommands::request<CCTalk::Header::RequestInsertionCounter>(_cct, device.address, n_reply); break;
+    case Accept:    n_res = CCTalkCommands::request<CCTalk::Header::RequestAcceptCounter>(_cct, device.address, n_reply); break;
+    case Reject:    n_res = CCTalkCommands::request<CCTalk::Header::RequestRejectCounter>(_cct, device.address, n_reply); break;
+    case Fraud:     n_res = CCTalkCommands::request<CCTalk::Header::RequestFraudCounter>(_cct, device.address, n_reply); break;
+    default:
+        return -1;
+    }
+    if(n_res != 0) return -1;
+
+    device.current[device.step] = n_reply.value;
+    device.known |= (uint8_t)(1 << device.step);
+    if(!device.hasSnapshot || n_reply.value != device.snapshot[device.step]) device.mask |= (uint8_t)(1 << device.step);
+    return 0;
+}
+
+int CCTalkAudit::service(){
+    if(_devices.empty()) return 0;
+    auto n_now = std::chrono::steady_clock::now();
+    if(n_now < _nextRead) return 0;
+    _nextRead = n_now + _interval;
+
+    if(_current >= _devices.size()) _current = 0;
+    Device &n_device = _devices[_current];
+
+    int n_res = readStep(n_device);
+
+    // Move on even after an error, one silent device must not stall the others.
+    // Only counters read without error are in the mask, absolute values wait
+    // until every counter has been read once.
+    const int n_steps = n_device.hasAuditBlock ? CounterCount + 1 : CounterCount;
+    if(++n_device.step >= n_steps) {
+        n_device.step = 0;
+        const bool n_complete = n_device.hasSnapshot || (n_device.known & CounterMask) == CounterMask;
+        if(n_complete && n_device.mask != 0) emit(n_device);
+        _current++;
+    }
+    return (n_res == 0) ? 1 : -1;
+}
+
+void CCTalkAudit::emit(Device &device){
+    uint8_t n_mask = device.mask;
+    if(!device.hasSnapshot) n_mask |= Absolute | CounterMask;
+
+    _records.push_back(device.address);
+    _records.push_back(n_mask);
+    for(int n_index = 0; n_index < CounterCount; n_index++) {
+        if(!(n_mask & (1 << n_index))) continue;
+        if(n_mask & Absolute) putVarint(device.current[n_index]);
+        else putVarint((device.current[n_index] - device.snapshot[n_index]) & CounterWrapMask);
+        device.snapshot[n_index] = device.current[n_index];
+    }
+    if(n_mask & AuditBlock) {
+        _records.push_back((uint8_t)device.auditBlock.size());
+        _records.insert(_records.end(), device.auditBlock.begin(), device.auditBlock.end());
+    }
+    device.hasSnapshot = true;
+    device.mask = 0;
+}
+
+void CCTalkAudit::putVarint(uint32_t value){
+    while(value >= 0x80) {
+        _records.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    _records.push_back((uint8_t)value);
+}
+
+int CCTalkAudit::takeRecords(std::vector<uint8_t> &buffer){
+    int n_size = (int)_records.size();
+    buffer.insert(buffer.end(), _records.begin(), _records.end());
+    _records.clear();
+    return n_size;
+}
+
+int CCTalkAudit::decode(const uint8_t *data, const int len, Delta &delta){
+    if(len < 2) return -1;
+    int n_pos = 0;
+    delta.address = data[n_pos++];
+    delta.mask = data[n_pos++];
+    delta.auditBlock.clear();
+
+    for(int n_index = 0; n_index < CounterCount; n_index++) {
+        delta.values[n_index] = 0;
+        if(!(delta.mask & (1 << n_index))) continue;
+        int n_shift = 0;
+        while(true) {
+            if(n_pos >= len || n_shift > 28) return -1;
+            uint8_t n_byte = data[n_pos++];
+            delta.values[n_index] |= (uint32_t)(n_byte & 0x7F) << n_shift;
+            if(!(n_byte & 0x80)) break;
+            n_shift += 7;
+        }
+    }
+
+    if(delta.mask & AuditBlock) {
+        if(n_pos >= len) return -1;
+        int n_blockLen = data[n_pos++];
+        if(n_pos + n_blockLen > len) return -1;
+        delta.auditBlock.assign(data + n_pos, data + n_pos + n_blockLen);
+        n_pos += n_blockLen;
+    }
+    return n_pos;
+}
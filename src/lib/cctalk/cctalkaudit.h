@@ -0,0 +1,149 @@
+/**
+ * @file cctalkaudit.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Incremental CCTalk audit counter collection with delta records
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _CCTALK_AUDIT_H_
+#define _CCTALK_AUDIT_H_
+
+#include "cctalk.h"
+#include <chrono>
+#include <vector>
+
+/**
+ * @brief Collects audit counters in the background.
+ * Each call to service() reads at most one counter, so the collector never takes
+ * more than one frame of bus time per interval. When all counters of a device have
+ * been read a delta record is queued, but only if something changed. A record only
+ * carries the counters read successfully in that cycle.
+ *
+ * Record layout:
+ *   [address][mask][varint value for each bit set in CounterMask][block length][block bytes]
+ * The first record of a device has the Absolute bit set and carries absolute values,
+ * it is queued once every counter has been read. Later records carry the increase
+ * since the previous record. Varints are LEB128.
+ */
+class CCTalkAudit {
+    public:
+    /** @brief Counters, in the order they appear in a record */
+    enum Counter {
+        Insertion   = 0,
+        Accept      = 1,
+        Reject      = 2,
+        Fraud       = 3,
+        CounterCount = 4
+    };
+
+    /** @brief Mask bits */
+    enum Mask {
+        CounterMask = 0x0F,     /*!< One bit per counter */
+        AuditBlock  = 0x10,     /*!< Record carries the audit info block */
+        Absolute    = 0x80      /*!< Values are absolute, not deltas */
+    };
+
+    /** @brief Decoded record */
+    class Delta {
+        public:
+        Delta() : address(0), mask(0){ for(int n_index = 0; n_index < CounterCount; n_index++) values[n_index] = 0; }
+        uint8_t address;
+        uint8_t mask;
+        uint32_t values[CounterCount];
+        std::vector<uint8_t> auditBlock;
+    };
+
+    public:
+    CCTalkAudit(CCTalk &cct);
+    ~CCTalkAudit();
+
+    /**
+     * @brief Add a device to collect from
+     *
+     * @param address Device address
+     * @param auditBlock Device supports RequestAuditInfoBlock
+     * @return Success
+     */
+    int addDevice(const uint8_t address, const bool auditBlock=false);
+
+    /**
+     * @brief Read the next counter if the interval has passed
+     *
+     * @return 1 if a counter was read, 0 if not due and -1 on error
+     */
+    int service();
+
+    /**
+     * @brief Set the time between two counter reads
+     *
+     * @param intervalMs Interval in milli seconds
+     */
+    void setInterval(const int intervalMs);
+
+    /**
+     * @brief Move the queued records to a buffer
+     *
+     * @param buffer Reference to the buffer, records are appended
+     * @return Number of bytes appended
+     */
+    int takeRecords(std::vector<uint8_t> &buffer);
+
+    /**
+     * @brief Decode one record
+     *
+     * @param data Pointer to record data
+     * @param len Number of bytes available
+     * @param delta Reference to the decoded record
+     * @return Number of bytes used or -1 if the record is incomplete
+     */
+    static int decode(const uint8_t *data, const int len, Delta &delta);
+
+    private:
+    /** @brief Device state */
+    struct Device {
+        uint8_t address;
+        bool hasAuditBlock;
+        bool hasSnapshot;
+        int step;
+        uint8_t mask;           // Changed counters read this cycle, and AuditBlock
+        uint8_t known;          // Counters read at least once
+        uint32_t snapshot[CounterCount];
+        uint32_t current[CounterCount];
+        std::vector<uint8_t> auditBlock;
+    };
+
+    /**
+     * @brief Read the counter or block of the current step
+     *
+     * @param device Device state
+     * @return Success
+     */
+    int readStep(Device &device);
+
+    /**
+     * @brief Queue the record of a device and move the snapshot forward
+     *
+     * @param device Device state
+     */
+    void emit(Device &device);
+
+    /**
+     * @brief Append a LEB128 varint
+     *
+     * @param value Value
+     */
+    void putVarint(uint32_t value);
+
+    private:
+    CCTalk &_cct;
+    std::vector<Device> _devices;
+    size_t _current;
+    std::vector<uint8_t> _records;
+    std::chrono::milliseconds _interval;
+    std::chrono::steady_clock::time_point _nextRead;
+};
+
+#endif //_CCTALK_AUDIT_H_
@@ -0,0 +1,157 @@
+/**
+ * @file cctalkcache.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Cached identity and configuration data per CCTalk device
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include "cctalkcache.h"
+#include "cctalkcommands.h"
+
+CCTalkDeviceCache::CCTalkDeviceCache(CCTalk &cct) : _cct(cct){ }
+
+CCTalkDeviceCache::~CCTalkDeviceCache(){ }
+
+CCTalkDeviceCache::Entry &CCTalkDeviceCache::entry(const uint8_t address){
+    const uint32_t n_resets = _cct.getResetCount(address);
+    auto n_it = _entries.find(address);
+    if(n_it != _entries.end() && n_it->second.resetCount != n_resets) invalidate(address);
+
+    auto n_res = _entries.emplace(address, Entry());
+    if(n_res.second) n_res.first->second.resetCount = n_resets;
+    return n_res.first->second;
+}
+
+int CCTalkDeviceCache::getText(const uint8_t address, const CCTalk::Header header, const Field field, std::string &value){
+    Entry &n_entry = entry(address);
+    std::string *n_value = nullptr;
+
+    switch (field)
+    {
+    case Manufacturer:  n_value = &n_entry.manufacturer; break;
+    case Category:      n_value = &n_entry.category; break;
+    case Product:       n_value = &n_entry.product; break;
+    case Software:      n_value = &n_entry.software; break;
+    case Build:         n_value = &n_entry.build; break;
+    default:
+        return -1;
+    }
+
+    if(!(n_entry.valid & field)) {
+        CCTalkPackage n_recvPack;
+        if(_cct.sendCommand(address, header, nullptr, 0, n_recvPack) != 0) return -1;
+        n_value->assign((const char*)n_recvPack.data, n_recvPack.length);
+        n_entry.valid |= field;
+    }
+    value = *n_value;
+    return 0;
+}
+
+int CCTalkDeviceCache::getManufacturerId(const uint8_t address, std::string &value){
+    return getText(address, CCTalk::Header::RequestManufactId, Manufacturer, value);
+}
+
+int CCTalkDeviceCache::getCategory(const uint8_t address, std::string &value){
+    return getText(address, CCTalk::Header::RequestEquiptCatId, Category, value);
+}
+
+int CCTalkDeviceCache::getProductCode(const uint8_t address, std::string &value){
+    return getText(address, CCTalk::Header::RequestProductCode, Product, value);
+}
+
+int CCTalkDeviceCache::getSoftwareVersion(const uint8_t address, std::string &value){
+    return getText(address, CCTalk::Header::RequestSoftwareVer, Software, value);
+}
+
+int CCTalkDeviceCache::getBuildCode(const uint8_t address, std::string &value){
+    return getText(address, CCTalk::Header::RequestBuildCode, Build, value);
+}
+
+int CCTalkDeviceCache::getSerialNo(const uint8_t address, uint32_t &value){
+    Entry &n_entry = entry(address);
+    if(!(n_entry.valid & SerialNo)) {
+        CCTalkCommands::Counter24Reply n_reply;
+        if(CCTalkCommands::request<CCTalk::Header::RequestSerialNo>(_cct, address, n_reply) != 0) return -1;
+        n_entry.serialNo = n_reply.value;
+        n_entry.valid |= SerialNo;
+    }
+    value = n_entry.serialNo;
+    return 0;
+}
+
+int CCTalkDeviceCache::getInhibitMask(const uint8_t address, uint16_t &value){
+    Entry &n_entry = entry(address);
+    if(!(n_entry.valid & InhibitMask)) {
+        CCTalkCommands::WordReply n_reply;
+        if(CCTalkCommands::request<CCTalk::Header::RequestInhibitStatus>(_cct, address, n_reply) != 0) return -1;
+        n_entry.inhibitMask = n_reply.value;
+        n_entry.valid |= InhibitMask;
+    }
+    value = n_entry.inhibitMask;
+    return 0;
+}
+
+int CCTalkDeviceCache::setInhibitMask(const uint8_t address, const uint16_t value){
+    Entry &n_entry = entry(address);
+    uint8_t n_data[2] = { (uint8_t)(value & 0xFF), (uint8_t)(value >> 8) };
+    CCTalkCommands::EmptyReply n_reply;
+
+    if(CCTalkCommands::request<CCTalk::Header::ModifyInhibitStatus>(_cct, address, n_data, 2, n_reply) != 0) {
+        n_entry.valid &= ~InhibitMask;
+        return -1;
+    }
+    n_entry.inhibitMask = value;
+    n_entry.valid |= InhibitMask;
+    return 0;
+}
+
+int CCTalkDeviceCache::getCoinId(const uint8_t address, const uint8_t coin, std::string &value){
+    if(coin < 1 || coin > CoinCount) return -1;
+    Entry &n_entry = entry(address);
+    const uint16_t n_bit = (uint16_t)(1 << (coin - 1));
+
+    if(!(n_entry.coinValid & n_bit)) {
+        CCTalkCommands::TextReply n_reply;
+        if(CCTalkCommands::request<CCTalk::Header::RequestCoinId>(_cct, address, &coin, 1, n_reply) != 0) return -1;
+        n_entry.coinId[coin - 1] = n_reply.text;
+        n_entry.coinValid |= n_bit;
+    }
+    value = n_entry.coinId[coin - 1];
+    return 0;
+}
+
+int CCTalkDeviceCache::resetDevice(const uint8_t address){
+    CCTalkCommands::EmptyReply n_reply;
+    invalidate(address);
+    return CCTalkCommands::request<CCTalk::Header::ResetDevice>(_cct, address, n_reply);
+}
+
+int CCTalkDeviceCache::validate(const uint8_t address){
+    auto n_it = _entries.find(address);
+    if(n_it == _entries.end()) return 0;
+    // A reset seen by getEventStack() drops the cache as well
+    const bool n_reset = n_it->second.resetCount != _cct.getResetCount(address);
+
+    CCTalkCommands::Counter24Reply n_reply;
+    if(CCTalkCommands::request<CCTalk::Header::RequestSerialNo>(_cct, address, n_reply) != 0) return -1;
+
+    if(!n_reset && (n_it->second.valid & SerialNo) && n_it->second.serialNo == n_reply.value) return 0;
+
+    // Reset, unknown or different serial number, the device may have been swapped
+    invalidate(address);
+    Entry &n_entry = entry(address);
+    n_entry.serialNo = n_reply.value;
+    n_entry.valid = SerialNo;
+    return 1;
+}
+
+void CCTalkDeviceCache::invalidate(const uint8_t address){
+    _entries.erase(address);
+}
+
+void CCTalkDeviceCache::invalidateAll(){
+    _entries.clear();
+}
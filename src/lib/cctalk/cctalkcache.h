@@ -0,0 +1,197 @@
+/**
+ * @file cctalkcache.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Cached identity and configuration data per CCTalk device
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _CCTALK_CACHE_H_
+#define _CCTALK_CACHE_H_
+
+#include "cctalk.h"
+#include <map>
+#include <string>
+
+/**
+ * @brief Lazily filled per device cache.
+ * Identification data only changes when the device is swapped, so every value
+ * is read from the bus once and served from memory after that. The cache of a
+ * device is dropped when it is reset, including resets getEventStack() notices,
+ * or reports a different serial number.
+ */
+class CCTalkDeviceCache {
+    public:
+    /** @brief Number of coin positions reported by RequestCoinId */
+    static const int CoinCount = 16;
+
+    public:
+    CCTalkDeviceCache(CCTalk &cct);
+    ~CCTalkDeviceCache();
+
+    /**
+     * @brief Get the manufacturer id
+     *
+     * @param address Device address
+     * @param value Reference to the manufacturer id
+     * @return Success
+     */
+    int getManufacturerId(const uint8_t address, std::string &value);
+
+    /**
+     * @brief Get the equipment category
+     *
+     * @param address Device address
+     * @param value Reference to the category
+     * @return Success
+     */
+    int getCategory(const uint8_t address, std::string &value);
+
+    /**
+     * @brief Get the product code
+     *
+     * @param address Device address
+     * @param value Reference to the product code
+     * @return Success
+     */
+    int getProductCode(const uint8_t address, std::string &value);
+
+    /**
+     * @brief Get the software revision
+     *
+     * @param address Device address
+     * @param value Reference to the software revision
+     * @return Success
+     */
+    int getSoftwareVersion(const uint8_t address, std::string &value);
+
+    /**
+     * @brief Get the build code
+     *
+     * @param address Device address
+     * @param value Reference to the build code
+     * @return Success
+     */
+    int getBuildCode(const uint8_t address, std::string &value);
+
+    /**
+     * @brief Get the serial number
+     *
+     * @param address Device address
+     * @param value Reference to the serial number
+     * @return Success
+     */
+    int getSerialNo(const uint8_t address, uint32_t &value);
+
+    /**
+     * @brief Get the inhibit mask, bit n set enables coin n + 1
+     *
+     * @param address Device address
+     * @param value Reference to the mask
+     * @return Success
+     */
+    int getInhibitMask(const uint8_t address, uint16_t &value);
+
+    /**
+     * @brief Set the inhibit mask on the device and in the cache
+     *
+     * @param address Device address
+     * @param value Mask, bit n set enables coin n + 1
+     * @return Success
+     */
+    int setInhibitMask(const uint8_t address, const uint16_t value);
+
+    /**
+     * @brief Get the coin id (ie. "EU200A") of a coin position
+     *
+     * @param address Device address
+     * @param coin Coin position 1 - 16
+     * @param value Reference to the coin id
+     * @return Success
+     */
+    int getCoinId(const uint8_t address, const uint8_t coin, std::string &value);
+
+    /**
+     * @brief Reset the device and drop its cache
+     *
+     * @param address Device address
+     * @return Success
+     */
+    int resetDevice(const uint8_t address);
+
+    /**
+     * @brief Re-read the serial number and drop the cache if it changed.
+     * Cheap enough to call after every reconnect.
+     *
+     * @param address Device address
+     * @return 1 if the cache was dropped, 0 if still valid and -1 on error
+     */
+    int validate(const uint8_t address);
+
+    /**
+     * @brief Drop the cache of a device
+     *
+     * @param address Device address
+     */
+    void invalidate(const uint8_t address);
+
+    /**
+     * @brief Drop the cache of all devices
+     */
+    void invalidateAll();
+
+    private:
+    /** @brief Cached values, the valid mask tells which are filled in */
+    struct Entry {
+        Entry() : resetCount(0), valid(0), coinValid(0), serialNo(0), inhibitMask(0){}
+        uint32_t resetCount;        // CCTalk::getResetCount() when the entry was created
+        uint32_t valid;
+        uint16_t coinValid;
+        std::string manufacturer;
+        std::string category;
+        std::string product;
+        std::string software;
+        std::string build;
+        uint32_t serialNo;
+        uint16_t inhibitMask;
+        std::string coinId[CoinCount];
+    };
+
+    /** @brief Bits in Entry::valid */
+    enum Field {
+        Manufacturer    = 1 << 0,
+        Category        = 1 << 1,
+        Product         = 1 << 2,
+        Software        = 1 << 3,
+        Build           = 1 << 4,
+        SerialNo        = 1 << 5,
+        InhibitMask     = 1 << 6
+    };
+
+    /**
+     * @brief Get the entry of a device, dropped first if the device was reset since it was filled
+     *
+     * @param address Device address
+     * @return Entry
+     */
+    Entry &entry(const uint8_t address);
+
+    /**
+     * @brief Get a text value, reading it from the device on a cache miss
+     *
+     * @param address Device address
+     * @param header Command that reads the value
+     * @param field Field bit
+     * @param value Reference to the value
+     * @return Success
+     */
+    int getText(const uint8_t address, const CCTalk::Header header, const Field field, std::string &value);
+
+    private:
+    CCTalk &_cct;
+    std::map<uint8_t, Entry> _entries;
+};
+
+#endif //_CCTALK_CACHE_H_
@@ -0,0 +1,328 @@
+/**
+ * @file cctalkcommands.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Compile time CCTalk command descriptors, frame encoding and typed reply decoding
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _CCTALK_COMMANDS_H_
+#define _CCTALK_COMMANDS_H_
+
+#include "cctalk.h"
+#include <array>
+#include <string>
+
+namespace CCTalkCommands {
+
+    /** @brief Marks a payload without a fixed length */
+    static constexpr int Variable = -1;
+
+    /**
+     * @brief Calculate the simple 8 bit checksum of a frame
+     *
+     * @param frame Frame bytes, the checksum byte excluded
+     * @param len Number of bytes
+     * @return Checksum value
+     */
+    constexpr uint8_t checksum(const uint8_t *frame, int len){
+        uint8_t n_sum = 0;
+        for(int n_pos = 0; n_pos < len; n_pos++) n_sum = (uint8_t)(n_sum + frame[n_pos]);
+        return (uint8_t)(0x100 - n_sum);
+    }
+
+    /** @brief Reply without payload (ACK) */
+    struct EmptyReply {
+        static constexpr int Length = 0;
+        void decode(const uint8_t *data, uint8_t length){ }
+    };
+
+    /** @brief ASCII text reply (manufacturer, category, product, build code and software version) */
+    struct TextReply {
+        static constexpr int Length = Variable;
+        std::string text;
+        void decode(const uint8_t *data, uint8_t length){ text.assign((const char*)data, length); }
+    };
+
+    /** @brief Single byte reply */
+    struct ByteReply {
+        static constexpr int Length = 1;
+        uint8_t value;
+        void decode(const uint8_t *data, uint8_t length){ value = data[0]; }
+    };
+
+    /** @brief 16 bit little endian reply (inhibit masks) */
+    struct WordReply {
+        static constexpr int Length = 2;
+        uint16_t value;
+        void decode(const uint8_t *data, uint8_t length){ value = (uint16_t)(data[0] | (data[1] << 8)); }
+    };
+
+    /** @brief 24 bit little endian reply (serial number and audit counters) */
+    struct Counter24Reply {
+        static constexpr int Length = 3;
+        uint32_t value;
+        void decode(const uint8_t *data, uint8_t length){
+            value = (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16);
+        }
+    };
+
+    /** @brief Fixed size binary reply (ie. cipher keys) */
+    template<int N>
+    struct BytesReply {
+        static constexpr int Length = N;
+        uint8_t bytes[N];
+        void decode(const uint8_t *data, uint8_t length){
+            for(int n_index = 0; n_index < N; n_index++) bytes[n_index] = data[n_index];
+        }
+    };
+
+    /** @brief Poll priority reply */
+    struct PollPriorityReply {
+        static constexpr int Length = 2;
+        uint8_t units;  // 0 = special, 1 = ms, 2 = x10 ms, 3 = seconds, 4 = minutes, 5 = hours, 6 = days, 7 = weeks, 8 = months, 9 = years
+        uint8_t value;
+        void decode(const uint8_t *data, uint8_t length){ units = data[0]; value = data[1]; }
+    };
+
+    /** @brief ReadBuffCreditOrErr reply, event counter followed by 5 result pairs */
+    struct EventBufferReply {
+        static constexpr int Length = 11;
+        static constexpr int EventCount = 5;
+        uint8_t eventCounter;
+        CCTalk::CCT_Event events[EventCount];
+        void decode(const uint8_t *data, uint8_t length){
+            eventCounter = data[0];
+            for(int n_index = 0; n_index < EventCount; n_index++)
+                events[n_index] = CCTalk::CCT_Event(data[1 + n_index * 2], data[2 + n_index * 2]);
+        }
+    };
+
+    /** @brief Hopper status reply */
+    struct HopperStatusReply {
+        static constexpr int Length = 4;
+        uint8_t eventCounter;
+        uint8_t remaining;
+        uint8_t paid;
+        uint8_t unpaid;
+        void decode(const uint8_t *data, uint8_t length){
+            eventCounter = data[0]; remaining = data[1]; paid = data[2]; unpaid = data[3];
+        }
+    };
+
+    /** @brief Data storage availability reply */
+    struct DataStorageReply {
+        static constexpr int Length = 5;
+        uint8_t memoryType;
+        uint8_t readBlocks;
+        uint8_t readBytesPerBlock;
+        uint8_t writeBlocks;
+        uint8_t writeBytesPerBlock;
+        void decode(const uint8_t *data, uint8_t length){
+            memoryType = data[0]; readBlocks = data[1]; readBytesPerBlock = data[2];
+            writeBlocks = data[3]; writeBytesPerBlock = data[4];
+        }
+    };
+
+    /** @brief Comms revision reply */
+    struct CommsRevisionReply {
+        static constexpr int Length = 3;
+        uint8_t releaseLevel;
+        uint8_t majorRevision;
+        uint8_t minorRevision;
+        void decode(const uint8_t *data, uint8_t length){
+            releaseLevel = data[0]; majorRevision = data[1]; minorRevision = data[2];
+        }
+    };
+
+    /**
+     * @brief Command payload layout
+     *
+     * @tparam RequestLen Number of request data bytes or Variable
+     * @tparam ReplyType Typed reply object
+     */
+    template<int RequestLen, typename ReplyType>
+    struct Layout {
+        static constexpr int RequestLength = RequestLen;
+        static constexpr int ReplyLength = ReplyType::Length;
+        typedef ReplyType Reply;
+    };
+
+    /** @brief Command descriptor, only described headers may be used with the helpers below */
+    template<CCTalk::Header H> struct Command;
+
+    template<> struct Command<CCTalk::Header::SimplePoll>               : Layout<0, EmptyReply> {};
+    template<> struct Command<CCTalk::Header::AddressPoll>              : Layout<0, EmptyReply> {}; // Unframed, timed reply
+    template<> struct Command<CCTalk::Header::AddressClash>             : Layout<0, EmptyReply> {}; // Unframed, timed reply
+    template<> struct Command<CCTalk::Header::AddressRandom>            : Layout<0, EmptyReply> {};
+    template<> struct Command<CCTalk::Header::RequestPollPriority>      : Layout<0, PollPriorityReply> {};
+    template<> struct Command<CCTalk::Header::RequestStatus>            : Layout<0, ByteReply> {};
+    template<> struct Command<CCTalk::Header::RequestManufactId>        : Layout<0, TextReply> {};
+    template<> struct Command<CCTalk::Header::RequestEquiptCatId>       : Layout<0, TextReply> {};
+    template<> struct Command<CCTalk::Header::RequestProductCode>       : Layout<0, TextReply> {};
+    template<> struct Command<CCTalk::Header::RequestSerialNo>          : Layout<0, Counter24Reply> {};
+    template<> struct Command<CCTalk::Header::RequestSoftwareVer>       : Layout<0, TextReply> {};
+    template<> struct Command<CCTalk::Header::RequestBuildCode>         : Layout<0, TextReply> {};
+    template<> struct Command<CCTalk::Header::PerformSelfCheck>         : Layout<0, ByteReply> {};
+    template<> struct Command<CCTalk::Header::ModifyInhibitStatus>      : Layout<2, EmptyReply> {};
+    template<> struct Command<CCTalk::Header::RequestInhibitStatus>     : Layout<0, WordReply> {};
+    template<> struct Command<CCTalk::Header::ReadBuffCreditOrErr>      : Layout<0, EventBufferReply> {};
+    template<> struct Command<CCTalk::Header::ModifyMasterInhibit>      : Layout<1, EmptyReply> {};
+    template<> struct Command<CCTalk::Header::RequestMasterInhibit>     : Layout<0, ByteReply> {};
+    template<> struct Command<CCTalk::Header::RequestInsertionCounter>  : Layout<0, Counter24Reply> {};
+    template<> struct Command<CCTalk::Header::RequestAcceptCounter>     : Layout<0, Counter24Reply> {};
+    template<> struct Command<CCTalk::Header::RequestDataStorageAvail>  : Layout<0, DataStorageReply> {};
+    template<> struct Command<CCTalk::Header::RequestRejectCounter>     : Layout<0, Counter24Reply> {};
+    template<> struct Command<CCTalk::Header::RequestFraudCounter>      : Layout<0, Counter24Reply> {};
+    template<> struct Command<CCTalk::Header::RequestCoinId>            : Layout<1, TextReply> {};
+    template<> struct Command<CCTalk::Header::RequestHopperStatus>      : Layout<0, HopperStatusReply> {};
+    template<> struct Command<CCTalk::Header::EnableHopper>             : Layout<1, EmptyReply> {};
+    template<> struct Command<CCTalk::Header::EmergencyStop>            : Layout<0, ByteReply> {};
+    template<> struct Command<CCTalk::Header::PumpRNG>                  : Layout<8, EmptyReply> {};
+    template<> struct Command<CCTalk::Header::RequestCipherKey>         : Layout<0, BytesReply<8> > {};
+    template<> struct Command<CCTalk::Header::RequestCommsRevision>     : Layout<0, CommsRevisionReply> {};
+    template<> struct Command<CCTalk::Header::ResetDevice>              : Layout<0, EmptyReply> {};
+
+    /**
+     * @brief Get the longest reply data of a header
+     *
+     * @tparam H Command header
+     * @return Number of data bytes
+     */
+    template<CCTalk::Header H>
+    constexpr int replyLimit(){
+        return (Command<H>::ReplyLength == Variable) ? 255 : Command<H>::ReplyLength;
+    }
+
+    /**
+     * @brief Get the longest reply data of a header at run time, for the frame parser
+     *
+     * @param header Command header
+     * @return Number of data bytes, 255 for headers without a descriptor
+     */
+    inline int replyLimit(const uint8_t header){
+        switch((CCTalk::Header)header) {
+        case CCTalk::Header::SimplePoll:               return replyLimit<CCTalk::Header::SimplePoll>();
+        case CCTalk::Header::AddressPoll:              return replyLimit<CCTalk::Header::AddressPoll>();
+        case CCTalk::Header::AddressClash:             return replyLimit<CCTalk::Header::AddressClash>();
+        case CCTalk::Header::AddressRandom:            return replyLimit<CCTalk::Header::AddressRandom>();
+        case CCTalk::Header::RequestPollPriority:      return replyLimit<CCTalk::Header::RequestPollPriority>();
+        case CCTalk::Header::RequestStatus:            return replyLimit<CCTalk::Header::RequestStatus>();
+        case CCTalk::Header::RequestManufactId:        return replyLimit<CCTalk::Header::RequestManufactId>();
+        case CCTalk::Header::RequestEquiptCatId:       return replyLimit<CCTalk::Header::RequestEquiptCatId>();
+        case CCTalk::Header::RequestProductCode:       return replyLimit<CCTalk::Header::RequestProductCode>();
+        case CCTalk::Header::RequestSerialNo:          return replyLimit<CCTalk::Header::RequestSerialNo>();
+        case CCTalk::Header::RequestSoftwareVer:       return replyLimit<CCTalk::Header::RequestSoftwareVer>();
+        case CCTalk::Header::RequestBuildCode:         return replyLimit<CCTalk::Header::RequestBuildCode>();
+        case CCTalk::Header::PerformSelfCheck:         return replyLimit<CCTalk::Header::PerformSelfCheck>();
+        case CCTalk::Header::ModifyInhibitStatus:      return replyLimit<CCTalk::Header::ModifyInhibitStatus>();
+        case CCTalk::Header::RequestInhibitStatus:     return replyLimit<CCTalk::Header::RequestInhibitStatus>();
+        case CCTalk::Header::ReadBuffCreditOrErr:      return replyLimit<CCTalk::Header::ReadBuffCreditOrErr>();
+        case CCTalk::Header::ModifyMasterInhibit:      return replyLimit<CCTalk::Header::ModifyMasterInhibit>();
+        case CCTalk::Header::RequestMasterInhibit:     return replyLimit<CCTalk::Header::RequestMasterInhibit>();
+        case CCTalk::Header::RequestInsertionCounter:  return replyLimit<CCTalk::Header::RequestInsertionCounter>();
+        case CCTalk::Header::RequestAcceptCounter:     return replyLimit<CCTalk::Header::RequestAcceptCounter>();
+        case CCTalk::Header::RequestDataStorageAvail:  return replyLimit<CCTalk::Header::RequestDataStorageAvail>();
+        case CCTalk::Header::RequestRejectCounter:     return replyLimit<CCTalk::Header::RequestRejectCounter>();
+        case CCTalk::Header::RequestFraudCounter:      return replyLimit<CCTalk::Header::RequestFraudCounter>();
+        case CCTalk::Header::RequestCoinId:            return replyLimit<CCTalk::Header::RequestCoinId>();
+        case CCTalk::Header::RequestHopperStatus:      return replyLimit<CCTalk::Header::RequestHopperStatus>();
+        case CCTalk::Header::EnableHopper:             return replyLimit<CCTalk::Header::EnableHopper>();
+        case CCTalk::Header::EmergencyStop:            return replyLimit<CCTalk::Header::EmergencyStop>();
+        case CCTalk::Header::PumpRNG:                  return replyLimit<CCTalk::Header::PumpRNG>();
+        case CCTalk::Header::RequestCipherKey:         return replyLimit<CCTalk::Header::RequestCipherKey>();
+        case CCTalk::Header::RequestCommsRevision:     return replyLimit<CCTalk::Header::RequestCommsRevision>();
+        case CCTalk::Header::ResetDevice:              return replyLimit<CCTalk::Header::ResetDevice>();
+        default: return 255;
+        }
+    }
+
+    /**
+     * @brief Encode a frame without request data
+     *
+     * @tparam H Command header
+     * @param receiverID Id of the device that should respond
+     * @param senderID Id of the sender
+     * @return Complete frame including checksum
+     */
+    template<CCTalk::Header H>
+    constexpr std::array<uint8_t, 5> encodeFrame(const uint8_t receiverID, const uint8_t senderID){
+        static_assert(Command<H>::RequestLength == 0, "Command takes request data");
+        std::array<uint8_t, 5> n_frame{ { receiverID, 0, senderID, (uint8_t)H, 0 } };
+        uint8_t n_head[4] = { receiverID, 0, senderID, (uint8_t)H };
+        n_frame[4] = checksum(n_head, 4);
+        return n_frame;
+    }
+
+    /**
+     * @brief Frame with fixed addresses, computed at compile time
+     *
+     * @tparam ReceiverID Id of the device that should respond
+     * @tparam SenderID Id of the sender
+     * @tparam H Command header
+     */
+    template<uint8_t ReceiverID, uint8_t SenderID, CCTalk::Header H>
+    struct StaticFrame {
+        static constexpr std::array<uint8_t, 5> value = encodeFrame<H>(ReceiverID, SenderID);
+    };
+
+    template<uint8_t ReceiverID, uint8_t SenderID, CCTalk::Header H>
+    constexpr std::array<uint8_t, 5> StaticFrame<ReceiverID, SenderID, H>::value;
+
+    /**
+     * @brief Decode a reply package into its typed reply object
+     *
+     * @tparam H Command header the reply belongs to
+     * @param package Received package
+     * @param reply Reference to the typed reply object
+     * @return Success, -1 if the package isn't a valid reply
+     */
+    template<CCTalk::Header H>
+    int decode(const CCTalkPackage &package, typename Command<H>::Reply &reply){
+        if(package.header != (uint8_t)CCTalk::Header::ReturnMessage) return -1;
+        if(Command<H>::ReplyLength != Variable && package.length != Command<H>::ReplyLength) return -1;
+        reply.decode(package.data, package.length);
+        return 0;
+    }
+
+    /**
+     * @brief Send a command without request data and decode the reply
+     *
+     * @tparam H Command header
+     * @param cct Bus object
+     * @param receiverID Id of the device that should respond
+     * @param reply Reference to the typed reply object
+     * @return Success
+     */
+    template<CCTalk::Header H>
+    int request(CCTalk &cct, const uint8_t receiverID, typename Command<H>::Reply &reply){
+        const std::array<uint8_t, 5> n_frame = encodeFrame<H>(receiverID, cct.getId());
+        CCTalkPackage n_recvPack;
+        if(cct.transmitFrameWithReply(n_frame.data(), (int)n_frame.size(), n_recvPack) != 0) return -1;
+        return decode<H>(n_recvPack, reply);
+    }
+
+    /**
+     * @brief Send a command with request data and decode the reply
+     *
+     * @tparam H Command header
+     * @param cct Bus object
+     * @param receiverID Id of the device that should respond
+     * @param data Request data, Command<H>::RequestLength bytes
+     * @param length Number of request data bytes
+     * @param reply Reference to the typed reply object
+     * @return Success
+     */
+    template<CCTalk::Header H>
+    int request(CCTalk &cct, const uint8_t receiverID, const uint8_t *data, const uint8_t length,
+                typename Command<H>::Reply &reply){
+        if(Command<H>::RequestLength != Variable && length != Command<H>::RequestLength) return -1;
+        CCTalkPackage n_recvPack;
+        if(cct.sendCommand(receiverID, H, data, length, n_recvPack) != 0) return -1;
+        return decode<H>(n_recvPack, reply);
+    }
+}
+
+#endif //_CCTALK_COMMANDS_H_
@@ -0,0 +1,158 @@
+/**
+ * @file cctalkdatablock.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief CCTalk data storage block transfer (ReadDataBlock / WriteDataBlock)
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include "cctalkdatablock.h"
+#include "cctalkcommands.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+
+/** @brief Largest block that fits a WriteDataBlock frame next to the block number */
+static const uint16_t MaxWriteBlockSize = 254;
+
+CCTalkDataBlock::CCTalkDataBlock(CCTalk &cct) : _cct(cct){ }
+
+CCTalkDataBlock::~CCTalkDataBlock(){ }
+
+int CCTalkDataBlock::getGeometry(const uint8_t address, Geometry &geometry){
+    CCTalkCommands::DataStorageReply n_reply;
+    if(CCTalkCommands::request<CCTalk::Header::RequestDataStorageAvail>(_cct, address, n_reply) != 0) return -1;
+
+    // A block count of 0 means 256 blocks
+    geometry.memoryType = n_reply.memoryType;
+    geometry.readBlocks = (n_reply.readBlocks == 0) ? 256 : n_reply.readBlocks;
+    geometry.readBlockSize = n_reply.readBytesPerBlock;
+    geometry.writeBlocks = (n_reply.writeBlocks == 0) ? 256 : n_reply.writeBlocks;
+    geometry.writeBlockSize = n_reply.writeBytesPerBlock;
+    return 0;
+}
+
+int CCTalkDataBlock::readBlock(const uint8_t address, const uint8_t block, uint8_t *buffer, const uint32_t len){
+    CCTalkPackage n_recvPack;
+    if(_cct.sendCommand(address, CCTalk::Header::ReadDataBlock, &block, 1, n_recvPack) != 0) return -1;
+    if(n_recvPack.length < len) return -1;
+    memcpy(buffer, n_recvPack.data, len);
+    return 0;
+}
+
+int CCTalkDataBlock::read(const uint8_t address, uint8_t *buffer, const uint32_t size){
+    Geometry n_geometry;
+    if(getGeometry(address, n_geometry) != 0) return -1;
+    if(n_geometry.readBlockSize == 0) return 0;
+
+    uint32_t n_total = n_geometry.readSize();
+    if(n_total > size) n_total = size;
+
+    uint32_t n_done = 0;
+    for(uint16_t n_block = 0; n_block < n_geometry.readBlocks && n_done < n_total; n_block++) {
+        uint32_t n_len = n_total - n_done;
+        if(n_len > n_geometry.readBlockSize) n_len = n_geometry.readBlockSize;
+
+        if(readBlock(address, (uint8_t)n_block, buffer + n_done, n_len) != 0) return -1;
+        n_done += n_len;
+        if(_progressCallback) _progressCallback(n_total, n_done);
+    }
+    return (int)n_done;
+}
+
+int CCTalkDataBlock::write(const uint8_t address, const uint8_t *buffer, const uint32_t size){
+    Geometry n_geometry;
+    if(getGeometry(address, n_geometry) != 0) return -1;
+    if(n_geometry.writeBlockSize == 0) return (size == 0) ? 0 : -1;
+    if(n_geometry.writeBlockSize > MaxWriteBlockSize || size > n_geometry.writeSize()) return -1;
+
+    uint8_t n_data[CCTalk::MaxFrameSize];
+    uint32_t n_done = 0;
+    for(uint16_t n_block = 0; n_done < size; n_block++) {
+        uint32_t n_len = size - n_done;
+        if(n_len > n_geometry.writeBlockSize) n_len = n_geometry.writeBlockSize;
+
+        n_data[0] = (uint8_t)n_block;
+        memcpy(&n_data[1], buffer + n_done, n_len);
+        memset(&n_data[1 + n_len], 0xFF, n_geometry.writeBlockSize - n_len);
+
+        CCTalkPackage n_recvPack;
+        if(_cct.sendCommand(address, CCTalk::Header::WriteDataBlock, n_data,
+                            (uint8_t)(n_geometry.writeBlockSize + 1), n_recvPack) != 0) return -1;
+        n_done += n_len;
+        if(_progressCallback) _progressCallback(size, n_done);
+    }
+    return (int)n_done;
+}
+
+int CCTalkDataBlock::readToFile(const uint8_t address, const std::string filepath){
+    Geometry n_geometry;
+    if(getGeometry(address, n_geometry) != 0) return -1;
+
+    int n_file = open(filepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(n_file < 0) return -1;
+
+    uint8_t n_bffr[CCTalk::MaxFrameSize];
+    const uint32_t n_total = n_geometry.readSize();
+    uint32_t n_done = 0;
+    int n_return = 0;
+
+    for(uint16_t n_block = 0; n_block < n_geometry.readBlocks && n_geometry.readBlockSize > 0; n_block++) {
+        if(readBlock(address, (uint8_t)n_block, n_bffr, n_geometry.readBlockSize) != 0 ||
+           ::write(n_file, n_bffr, n_geometry.readBlockSize) != n_geometry.readBlockSize) {
+            n_return = -1;
+            break;
+        }
+        n_done += n_geometry.readBlockSize;
+        if(_progressCallback) _progressCallback(n_total, n_done);
+    }
+    close(n_file);
+    return (n_return == 0) ? (int)n_done : -1;
+}
+
+int CCTalkDataBlock::writeFromFile(const uint8_t address, const std::string filepath){
+    Geometry n_geometry;
+    if(getGeometry(address, n_geometry) != 0) return -1;
+    if(n_geometry.writeBlockSize == 0 || n_geometry.writeBlockSize > MaxWriteBlockSize) return -1;
+
+    int n_file = open(filepath.c_str(), O_RDONLY);
+    if(n_file < 0) return -1;
+
+    long n_size = lseek(n_file, 0, SEEK_END);
+    lseek(n_file, 0, SEEK_SET);
+    if(n_size < 0 || (uint32_t)n_size > n_geometry.writeSize()) {
+        close(n_file);
+        return -1;
+    }
+
+    uint8_t n_data[CCTalk::MaxFrameSize];
+    uint32_t n_done = 0;
+    int n_return = 0;
+
+    for(uint16_t n_block = 0; n_done < (uint32_t)n_size; n_block++) {
+        ssize_t n_len = ::read(n_file, &n_data[1], n_geometry.writeBlockSize);
+        if(n_len <= 0) {
+            n_return = -1;
+            break;
+        }
+        n_data[0] = (uint8_t)n_block;
+        memset(&n_data[1 + n_len], 0xFF, n_geometry.writeBlockSize - n_len);
+
+        CCTalkPackage n_recvPack;
+        if(_cct.sendCommand(address, CCTalk::Header::WriteDataBlock, n_data,
+                            (uint8_t)(n_geometry.writeBlockSize + 1), n_recvPack) != 0) {
+            n_return = -1;
+            break;
+        }
+        n_done += (uint32_t)n_len;
+        if(_progressCallback) _progressCallback((uint32_t)n_size, n_done);
+    }
+    close(n_file);
+    return (n_return == 0) ? (int)n_done : -1;
+}
+
+void CCTalkDataBlock::setProgressCallback(std::function<void(uint32_t, uint32_t)> callback){
+    _progressCallback = callback;
+}
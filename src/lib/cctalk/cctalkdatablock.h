@@ -0,0 +1,116 @@
+/**
+ * @file cctalkdatablock.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief CCTalk data storage block transfer (ReadDataBlock / WriteDataBlock)
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _CCTALK_DATABLOCK_H_
+#define _CCTALK_DATABLOCK_H_
+
+#include "cctalk.h"
+#include <functional>
+#include <string>
+
+/**
+ * @brief Transfers the user data area of a device.
+ * Blocks are sized to the geometry the device reports with RequestDataStorageAvail
+ * and sent back to back straight from/into the caller's buffer.
+ */
+class CCTalkDataBlock {
+    public:
+    /** @brief Storage geometry reported by the device */
+    class Geometry {
+        public:
+        Geometry() : memoryType(0), readBlocks(0), readBlockSize(0), writeBlocks(0), writeBlockSize(0){}
+        uint8_t memoryType;     // 0/1 = volatile, 2 = permanent limited use, 3 = permanent unlimited use
+        uint16_t readBlocks;
+        uint16_t readBlockSize;
+        uint16_t writeBlocks;
+        uint16_t writeBlockSize;
+
+        /** @brief Readable bytes in total */
+        uint32_t readSize() const { return (uint32_t)readBlocks * readBlockSize; }
+        /** @brief Writable bytes in total */
+        uint32_t writeSize() const { return (uint32_t)writeBlocks * writeBlockSize; }
+    };
+
+    public:
+    CCTalkDataBlock(CCTalk &cct);
+    ~CCTalkDataBlock();
+
+    /**
+     * @brief Get the storage geometry of a device
+     *
+     * @param address Device address
+     * @param geometry Reference to the geometry object
+     * @return Success
+     */
+    int getGeometry(const uint8_t address, Geometry &geometry);
+
+    /**
+     * @brief Read the data area into a buffer
+     *
+     * @param address Device address
+     * @param buffer Pointer to buffer
+     * @param size Size of the buffer, reading stops when it is full
+     * @return Number of bytes read or -1 on error
+     */
+    int read(const uint8_t address, uint8_t *buffer, const uint32_t size);
+
+    /**
+     * @brief Write a buffer to the data area
+     *
+     * @param address Device address
+     * @param buffer Pointer to data
+     * @param size Number of bytes, a partial last block is padded with 0xFF
+     * @return Number of bytes written or -1 on error
+     */
+    int write(const uint8_t address, const uint8_t *buffer, const uint32_t size);
+
+    /**
+     * @brief Read the data area into a file
+     *
+     * @param address Device address
+     * @param filepath Path to file
+     * @return Number of bytes read or -1 on error
+     */
+    int readToFile(const uint8_t address, const std::string filepath);
+
+    /**
+     * @brief Write a file to the data area
+     *
+     * @param address Device address
+     * @param filepath Path to file
+     * @return Number of bytes written or -1 on error
+     */
+    int writeFromFile(const uint8_t address, const std::string filepath);
+
+    /**
+     * @brief Set the Progress Callback object
+     *
+     * @param callback Callback function (total, transferred)
+     */
+    void setProgressCallback(std::function<void(uint32_t, uint32_t)> callback);
+
+    private:
+    /**
+     * @brief Read one block
+     *
+     * @param address Device address
+     * @param block Block number
+     * @param buffer Pointer to buffer
+     * @param len Number of bytes to copy into the buffer
+     * @return Success
+     */
+    int readBlock(const uint8_t address, const uint8_t block, uint8_t *buffer, const uint32_t len);
+
+    private:
+    CCTalk &_cct;
+    std::function<void(uint32_t, uint32_t)> _progressCallback;
+};
+
+#endif //_CCTALK_DATABLOCK_H_
@@ -0,0 +1,137 @@
+/**
+ * @file cctalkdiscovery.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief CCTalk bus enumeration using AddressPoll / AddressClash / AddressRandom
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include "cctalkdiscovery.h"
+#include "cctalkcommands.h"
+
+/** @brief Reply delay per address step for AddressPoll (ms) */
+static const int AddressPollStepMs = 4;
+/** @brief Extra time added to the response windows (ms) */
+static const int WindowMarginMs = 20;
+/** @brief Default highest address, the full range */
+static const uint8_t DefaultMaxAddress = 255;
+/** @brief Reply timeout of the identify probe (ms) */
+static const int ProbeTimeoutMs = 50;
+
+CCTalkDiscovery::CCTalkDiscovery() : _maxAddress(DefaultMaxAddress), _clashWindowMs(1100), _maxRounds(3){ }
+
+CCTalkDiscovery::~CCTalkDiscovery(){ }
+
+void CCTalkDiscovery::setMaxAddress(uint8_t maxAddress){
+    _maxAddress = maxAddress;
+}
+
+void CCTalkDiscovery::setClashWindow(int windowMs){
+    _clashWindowMs = windowMs;
+}
+
+void CCTalkDiscovery::setMaxRounds(int rounds){
+    _maxRounds = rounds;
+}
+
+int CCTalkDiscovery::scan(CCTalk &cct, std::vector<Device> &devices){
+    devices.clear();
+
+    for(int n_round = 0; n_round < _maxRounds; n_round++) {
+        std::vector<uint8_t> n_addresses;
+        if(addressPoll(cct, n_addresses) != 0) return -1;
+
+        std::vector<uint8_t> n_suspects;
+        devices.clear();
+        for(uint8_t n_address : n_addresses) {
+            Device n_device;
+            if(identify(cct, n_address, n_device) == 0) devices.push_back(n_device);
+            else n_suspects.push_back(n_address);
+        }
+        if(n_suspects.empty()) break;
+
+        // Two devices answering at once garble the reply, move them apart and rescan
+        bool n_moved = false;
+        for(uint8_t n_address : n_suspects) {
+            if(isClash(cct, n_address) == 1 && addressRandom(cct, n_address) == 0) n_moved = true;
+        }
+        if(!n_moved) break;
+    }
+    return (int)devices.size();
+}
+
+int CCTalkDiscovery::addressPoll(CCTalk &cct, std::vector<uint8_t> &addresses){
+    const std::array<uint8_t, 5> n_frame = CCTalkCommands::encodeFrame<CCTalk::Header::AddressPoll>(0, cct.getId());
+    uint8_t n_bffr[CCTalk::MaxFrameSize];
+
+    addresses.clear();
+    if(cct.transmitFrame(n_frame.data(), (int)n_frame.size()) != 0) return -1;
+
+    int n_read = cct.receiveWindow(n_bffr, sizeof(n_bffr), _maxAddress * AddressPollStepMs + WindowMarginMs);
+    if(n_read < 0) return -1;
+
+    // Replies arrive in address order, anything out of order is a collision and is dropped
+    int n_last = 0;
+    for(int n_pos = echoLength(n_bffr, n_read, n_frame); n_pos < n_read; n_pos++) {
+        uint8_t n_address = n_bffr[n_pos];
+        if(n_address <= n_last || n_address == cct.getId()) continue;
+        addresses.push_back(n_address);
+        n_last = n_address;
+    }
+    return 0;
+}
+
+int CCTalkDiscovery::isClash(CCTalk &cct, uint8_t address){
+    const std::array<uint8_t, 5> n_frame = CCTalkCommands::encodeFrame<CCTalk::Header::AddressClash>(address, cct.getId());
+    uint8_t n_bffr[CCTalk::MaxFrameSize];
+
+    if(cct.transmitFrame(n_frame.data(), (int)n_frame.size()) != 0) return -1;
+    int n_read = cct.receiveWindow(n_bffr, sizeof(n_bffr), _clashWindowMs);
+    if(n_read < 0) return -1;
+
+    int n_replies = n_read - echoLength(n_bffr, n_read, n_frame);
+    return (n_replies > 1) ? 1 : 0;
+}
+
+int CCTalkDiscovery::addressRandom(CCTalk &cct, uint8_t address){
+    const std::array<uint8_t, 5> n_frame = CCTalkCommands::encodeFrame<CCTalk::Header::AddressRandom>(address, cct.getId());
+    uint8_t n_bffr[CCTalk::MaxFrameSize];
+
+    if(cct.transmitFrame(n_frame.data(), (int)n_frame.size()) != 0) return -1;
+    // The ACKs of the clashing devices overlap, just let the bus settle
+    if(cct.receiveWindow(n_bffr, sizeof(n_bffr), WindowMarginMs * 5) < 0) return -1;
+    return 0;
+}
+
+int CCTalkDiscovery::identify(CCTalk &cct, uint8_t address, Device &device){
+    CCTalkCommands::TextReply n_text;
+    CCTalkCommands::Counter24Reply n_serial;
+
+    device.address = address;
+
+    // One short probe, a clash or a ghost address fails here without retries
+    const std::array<uint8_t, 5> n_frame = CCTalkCommands::encodeFrame<CCTalk::Header::RequestEquiptCatId>(address, cct.getId());
+    CCTalkPackage n_recvPack;
+    if(cct.probeFrame(n_frame.data(), (int)n_frame.size(), n_recvPack, ProbeTimeoutMs) != 0) return -1;
+    if(CCTalkCommands::decode<CCTalk::Header::RequestEquiptCatId>(n_recvPack, n_text) != 0) return -1;
+    device.category = n_text.text;
+    if(CCTalkCommands::request<CCTalk::Header::RequestManufactId>(cct, address, n_text) != 0) return -1;
+    device.manufacturer = n_text.text;
+    if(CCTalkCommands::request<CCTalk::Header::RequestProductCode>(cct, address, n_text) != 0) return -1;
+    device.product = n_text.text;
+
+    // Not a core command, devices without it are still valid
+    if(CCTalkCommands::request<CCTalk::Header::RequestSerialNo>(cct, address, n_serial) == 0)
+        device.serialNo = n_serial.value;
+    return 0;
+}
+
+int CCTalkDiscovery::echoLength(const uint8_t *buffer, int len, const std::array<uint8_t, 5> &frame){
+    if(len < (int)frame.size()) return 0;
+    for(size_t n_pos = 0; n_pos < frame.size(); n_pos++) {
+        if(buffer[n_pos] != frame[n_pos]) return 0;
+    }
+    return (int)frame.size();
+}
@@ -0,0 +1,131 @@
+/**
+ * @file cctalkdiscovery.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief CCTalk bus enumeration using AddressPoll / AddressClash / AddressRandom
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _CCTALK_DISCOVERY_H_
+#define _CCTALK_DISCOVERY_H_
+
+#include "cctalk.h"
+#include <array>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Finds the devices on a bus.
+ * A broadcast AddressPoll makes every device answer with its own address after
+ * 4 ms x address, so one timed window lists the whole bus. Addresses that do not
+ * identify cleanly are checked with AddressClash and moved with AddressRandom.
+ */
+class CCTalkDiscovery {
+    public:
+    /** @brief Device table entry */
+    class Device {
+        public:
+        Device() : address(0), serialNo(0){}
+        uint8_t address;
+        std::string category;       // Equipment category (ie. "Coin Acceptor", "Payout")
+        std::string manufacturer;
+        std::string product;
+        uint32_t serialNo;          // 0 if the device doesn't report a serial number
+    };
+
+    public:
+    CCTalkDiscovery();
+    ~CCTalkDiscovery();
+
+    /**
+     * @brief Scan the bus and build the device table
+     *
+     * @param cct Connected bus object
+     * @param devices Reference to the device table
+     * @return Number of devices found or -1 on error
+     */
+    int scan(CCTalk &cct, std::vector<Device> &devices);
+
+    /**
+     * @brief Set the highest address to wait for.
+     * The AddressPoll window is 4 ms x maxAddress. The default of 255 scans the full
+     * range in about 1 s (1040 ms), callers that know their highest address can
+     * narrow it here.
+     *
+     * @param maxAddress Highest address in use
+     */
+    void setMaxAddress(uint8_t maxAddress);
+
+    /**
+     * @brief Set the AddressClash response window
+     *
+     * @param windowMs Window in milli seconds
+     */
+    void setClashWindow(int windowMs);
+
+    /**
+     * @brief Set how many times clashes are resolved and the bus is rescanned
+     *
+     * @param rounds Number of rounds
+     */
+    void setMaxRounds(int rounds);
+
+    private:
+    /**
+     * @brief Send AddressPoll and collect the addresses answering
+     *
+     * @param cct Bus object
+     * @param addresses Reference to the address list
+     * @return Success
+     */
+    int addressPoll(CCTalk &cct, std::vector<uint8_t> &addresses);
+
+    /**
+     * @brief Check if more than one device answers on an address
+     *
+     * @param cct Bus object
+     * @param address Address to check
+     * @return 1 on clash, 0 if not and -1 on error
+     */
+    int isClash(CCTalk &cct, uint8_t address);
+
+    /**
+     * @brief Make the devices on an address pick a random address
+     *
+     * @param cct Bus object
+     * @param address Address to change
+     * @return Success
+     */
+    int addressRandom(CCTalk &cct, uint8_t address);
+
+    /**
+     * @brief Read identification data from a device.
+     * The address is first checked with one short probe, so garbled or silent
+     * addresses don't wait out the full retry path.
+     *
+     * @param cct Bus object
+     * @param address Device address
+     * @param device Reference to the table entry
+     * @return Success
+     */
+    int identify(CCTalk &cct, uint8_t address, Device &device);
+
+    /**
+     * @brief Get the number of leading bytes that are the echo of our own frame
+     *
+     * @param buffer Received bytes
+     * @param len Number of received bytes
+     * @param frame Transmitted frame
+     * @return Number of bytes to skip
+     */
+    static int echoLength(const uint8_t *buffer, int len, const std::array<uint8_t, 5> &frame);
+
+    private:
+    uint8_t _maxAddress;
+    int _clashWindowMs;
+    int _maxRounds;
+};
+
+#endif //_CCTALK_DISCOVERY_H_
@@ -0,0 +1,280 @@
+/**
+ * @file cctalkeventloop.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Non-blocking request loop for one or more CCTalk buses
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include "cctalkeventloop.h"
+#include <string.h>
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+CCTalkEventLoop::CCTalkEventLoop() : _replyTimeout(0), _running(false), _walking(0){ }
+
+CCTalkEventLoop::~CCTalkEventLoop(){ }
+
+int CCTalkEventLoop::addBus(CCTalk *bus){
+    if(bus == nullptr) return -1;
+    for(Bus &n_bus : _buses) {
+        if(n_bus.cct == bus && !n_bus.removed) return -1;
+    }
+    // Buses are walked by index and a deque keeps references on push_back,
+    // so a callback may add a bus while runOnce() is running
+    _buses.emplace_back();
+    _buses.back().cct = bus;
+    _buses.back().busy = false;
+    _buses.back().backoff = false;
+    _buses.back().removed = false;
+    _buses.back().attempt = 0;
+    return 0;
+}
+
+int CCTalkEventLoop::removeBus(CCTalk *bus){
+    for(size_t n_index = 0; n_index < _buses.size(); n_index++) {
+        Bus &n_bus = _buses[n_index];
+        if(n_bus.cct != bus || n_bus.removed) continue;
+
+        // Callbacks may remove buses too, erasing waits until nothing walks the list
+        _walking++;
+        n_bus.removed = true;
+        if(n_bus.busy) {
+            CCTalkPackage n_empty;
+            n_empty.length = 0;
+            complete(n_bus, -1, n_empty);
+        }
+        n_bus.queue.clear(-1);
+        _walking--;
+        purge();
+        return 0;
+    }
+    return -1;
+}
+
+void CCTalkEventLoop::purge(){
+    if(_walking > 0) return;
+    for(auto n_it = _buses.begin(); n_it != _buses.end(); ) {
+        if(n_it->removed) n_it = _buses.erase(n_it);
+        else n_it++;
+    }
+}
+
+int CCTalkEventLoop::request(CCTalk *bus, const uint8_t receiverID, const CCTalk::Header header,
+                             const uint8_t *data, const uint8_t length, Callback callback){
+    return request(bus, receiverID, header, data, length, callback,
+                   CCTalkCommandQueue::defaultPriority(header));
+}
+
+int CCTalkEventLoop::request(CCTalk *bus, const uint8_t receiverID, const CCTalk::Header header,
+                             const uint8_t *data, const uint8_t length, Callback callback, Priority priority){
+    CCTalkCommandQueue *n_queue = getQueue(bus);
+    if(n_queue == nullptr) return -1;
+
+    CCTalkCommandQueue::Command n_command;
+    n_command.receiverID = receiverID;
+    n_command.header = (uint8_t)header;
+    if(length > 0) n_command.data.assign(data, data + length);
+    n_command.callback = callback;
+    n_command.priority = priority;
+    n_queue->push(std::move(n_command));
+    return 0;
+}
+
+CCTalkCommandQueue *CCTalkEventLoop::getQueue(CCTalk *bus){
+    for(Bus &n_bus : _buses) {
+        if(n_bus.cct == bus && !n_bus.removed) return &n_bus.queue;
+    }
+    return nullptr;
+}
+
+int CCTalkEventLoop::pending() const {
+    int n_count = 0;
+    for(const Bus &n_bus : _buses) n_count += n_bus.queue.size() + (n_bus.busy ? 1 : 0);
+    return n_count;
+}
+
+void CCTalkEventLoop::setReplyTimeout(int timeoutMs){
+    _replyTimeout = std::chrono::milliseconds(timeoutMs);
+}
+
+void CCTalkEventLoop::complete(Bus &bus, int result, CCTalkPackage &reply){
+    // Release the bus before the callback so the callback may queue follow-up requests
+    Callback n_callback = std::move(bus.inflight.callback);
+    bus.inflight.callback = nullptr;
+    bus.busy = false;
+    bus.backoff = false;
+    if(n_callback) n_callback(result, reply);
+}
+
+std::chrono::milliseconds CCTalkEventLoop::replyTimeout(Bus &bus) const {
+    if(_replyTimeout.count() > 0) return _replyTimeout;
+    return std::chrono::milliseconds(bus.cct->getRetryPolicy().getTimeout(bus.inflight.header));
+}
+
+int CCTalkEventLoop::resend(Bus &bus){
+    bus.attempt++;
+    if(bus.cct->retransmit() != 0) {
+        CCTalkPackage n_empty;
+        n_empty.length = 0;
+        complete(bus, -1, n_empty);
+        return 1;
+    }
+    bus.sent = std::chrono::steady_clock::now();
+    bus.deadline = bus.sent + replyTimeout(bus);
+    return 0;
+}
+
+int CCTalkEventLoop::serviceBus(Bus &bus){
+    CCTalkRetryPolicy &n_retry = bus.cct->getRetryPolicy();
+    const uint8_t n_header = bus.inflight.header;
+    const bool n_lastAttempt = bus.attempt >= n_retry.getAttempts(n_header);
+    auto n_now = std::chrono::steady_clock::now();
+
+    if(bus.backoff) {
+        if(n_now < bus.deadline) return 0;
+        bus.backoff = false;
+        return resend(bus);
+    }
+
+    CCTalkPackage n_reply;
+    n_reply.length = 0;
+    int n_res = bus.cct->serviceTransaction(n_reply);
+    if(n_res == 0 && n_now < bus.deadline) return 0;
+
+    if(n_res == 1) {
+        n_retry.addSample(n_header, (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(n_now - bus.sent).count());
+        if(n_reply.header == (uint8_t)CCTalk::Header::NAKmessage) {
+            complete(bus, -2, n_reply);
+            return 1;
+        }
+        if(n_reply.header != (uint8_t)CCTalk::Header::BUSYmessage) {
+            complete(bus, 0, n_reply);
+            return 1;
+        }
+        if(n_lastAttempt) {
+            complete(bus, -3, n_reply);
+            return 1;
+        }
+        // Resend once the backoff has passed, without blocking the other buses
+        bus.backoff = true;
+        bus.deadline = n_now + std::chrono::milliseconds(n_retry.getBusyBackoff(bus.attempt - 1));
+        return 0;
+    }
+
+    // Timeouts and corrupted replies are worth a retransmit
+    if(n_lastAttempt) {
+        complete(bus, -1, n_reply);
+        return 1;
+    }
+    return resend(bus);
+}
+
+int CCTalkEventLoop::startNext(Bus &bus){
+    int n_failed = 0;
+    while(!bus.busy && !bus.removed && bus.queue.pop(bus.inflight) == 0) {
+        CCTalkCommandQueue::Command &n_request = bus.inflight;
+        CCTalkPackage n_sendPack;
+        n_sendPack.receiverID = n_request.receiverID;
+        n_sendPack.length = (uint8_t)n_request.data.size();
+        n_sendPack.senderID = bus.cct->getId();
+        n_sendPack.header = n_request.header;
+        if(n_sendPack.length > 0) memcpy(n_sendPack.data, n_request.data.data(), n_sendPack.length);
+        n_sendPack.crc = bus.cct->calcCrc(n_sendPack);
+
+        bus.busy = true;
+        bus.backoff = false;
+        bus.attempt = 1;
+        if(bus.cct->beginTransaction(n_sendPack) != 0) {
+            CCTalkPackage n_empty;
+            n_empty.length = 0;
+            complete(bus, -1, n_empty);
+            n_failed++;
+            continue;
+        }
+        bus.sent = std::chrono::steady_clock::now();
+        bus.deadline = bus.sent + replyTimeout(bus);
+    }
+    return n_failed;
+}
+
+void CCTalkEventLoop::waitForData(int timeoutMs){
+    auto n_now = std::chrono::steady_clock::now();
+    for(Bus &n_bus : _buses) {
+        if(!n_bus.busy) continue;
+        int n_left = (int)std::chrono::duration_cast<std::chrono::milliseconds>(n_bus.deadline - n_now).count();
+        if(n_left < timeoutMs) timeoutMs = (n_left < 0) ? 0 : n_left;
+    }
+
+#ifdef _WIN32
+    for(int n_waited = 0; n_waited < timeoutMs; n_waited++) {
+        for(Bus &n_bus : _buses) {
+            if(n_bus.busy && !n_bus.backoff && n_bus.cct->available() != 0) return;
+        }
+        Sleep(1);
+    }
+#else
+    std::vector<struct pollfd> n_fds;
+    for(Bus &n_bus : _buses) {
+        if(!n_bus.busy || n_bus.backoff) continue;
+        struct pollfd n_pfd;
+        n_pfd.fd = n_bus.cct->fileDescriptor();
+        n_pfd.events = POLLIN;
+        n_pfd.revents = 0;
+        n_fds.push_back(n_pfd);
+    }
+    poll(n_fds.empty() ? nullptr : n_fds.data(), n_fds.size(), timeoutMs);
+#endif
+}
+
+int CCTalkEventLoop::runOnce(int timeoutMs){
+    int n_completed = 0;
+    bool n_busy = false;
+
+    // Callbacks may add or remove buses, walk by index and erase afterwards
+    _walking++;
+    for(size_t n_index = 0; n_index < _buses.size(); n_index++) {
+        Bus &n_bus = _buses[n_index];
+        n_completed += startNext(n_bus);
+        if(n_bus.busy) n_busy = true;
+    }
+
+    if(n_busy) {
+        waitForData(timeoutMs);
+
+        for(size_t n_index = 0; n_index < _buses.size(); n_index++) {
+            Bus &n_bus = _buses[n_index];
+            if(!n_bus.busy || n_bus.removed) continue;
+            if(serviceBus(n_bus) == 0) continue;
+            n_completed++;
+
+            // Issue the next frame right away, the bus is free again
+            n_completed += startNext(n_bus);
+        }
+    }
+    _walking--;
+    purge();
+    return n_completed;
+}
+
+void CCTalkEventLoop::run(){
+    _running = true;
+    while(_running) {
+        if(runOnce(10) < 0) break;
+        if(pending() == 0) {
+#ifdef _WIN32
+            Sleep(1);
+#else
+            poll(nullptr, 0, 1);
+#endif
+        }
+    }
+}
+
+void CCTalkEventLoop::stop(){
+    _running = false;
+}
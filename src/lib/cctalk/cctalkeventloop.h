@@ -0,0 +1,200 @@
+/**
+ * @file cctalkeventloop.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Non-blocking request loop for one or more CCTalk buses
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _CCTALK_EVENTLOOP_H_
+#define _CCTALK_EVENTLOOP_H_
+
+#include "cctalk.h"
+#include "cctalkqueue.h"
+#include <deque>
+#include <vector>
+#include <chrono>
+#include <functional>
+
+/**
+ * @brief Multiplexes ccTalk requests for several buses on a single thread.
+ * Requests are queued per bus in priority lanes and issued one at a time, as the
+ * bus is half-duplex. The reply (or error) is handed to the callback given with the request.
+ * Timeouts, attempts and BUSY backoff come from the retry policy of each bus, as
+ * with the blocking CCTalk calls, and results use the same codes.
+ */
+class CCTalkEventLoop {
+    public:
+    /** @brief Completion callback, see CCTalkCommandQueue::Callback */
+    typedef CCTalkCommandQueue::Callback Callback;
+
+    /** @brief Request priority */
+    typedef CCTalkCommandQueue::Priority Priority;
+
+    CCTalkEventLoop();
+    ~CCTalkEventLoop();
+
+    /**
+     * @brief Add a connected bus to the loop
+     *
+     * @param bus Bus object (the loop does not take ownership)
+     * @return Success
+     */
+    int addBus(CCTalk *bus);
+
+    /**
+     * @brief Remove a bus, pending requests are completed with -1.
+     * May be called from a completion callback, the bus is then dropped once
+     * runOnce() has finished walking the buses.
+     *
+     * @param bus Bus object
+     * @return Success
+     */
+    int removeBus(CCTalk *bus);
+
+    /**
+     * @brief Queue a request in the default lane for its header
+     *
+     * @param bus Bus to send the request on
+     * @param receiverID Id of the device that should respond
+     * @param header Command header
+     * @param data Pointer to request data (may be nullptr when length is 0)
+     * @param length Number of data bytes
+     * @param callback Called when the reply is received or the request fails
+     * @return Success
+     */
+    int request(CCTalk *bus, const uint8_t receiverID, const CCTalk::Header header,
+                const uint8_t *data, const uint8_t length, Callback callback);
+
+    /**
+     * @brief Queue a request in a given lane
+     *
+     * @param bus Bus to send the request on
+     * @param receiverID Id of the device that should respond
+     * @param header Command header
+     * @param data Pointer to request data (may be nullptr when length is 0)
+     * @param length Number of data bytes
+     * @param callback Called when the reply is received or the request fails
+     * @param priority Lane to queue the request in
+     * @return Success
+     */
+    int request(CCTalk *bus, const uint8_t receiverID, const CCTalk::Header header,
+                const uint8_t *data, const uint8_t length, Callback callback, Priority priority);
+
+    /**
+     * @brief Get the command queue of a bus, ie. to tune the background share
+     *
+     * @param bus Bus object
+     * @return Pointer to the queue or nullptr if the bus isn't added
+     */
+    CCTalkCommandQueue *getQueue(CCTalk *bus);
+
+    /**
+     * @brief Issue queued requests and collect replies
+     *
+     * @param timeoutMs Max time to wait for incoming data
+     * @return Number of completed requests or -1 on error
+     */
+    int runOnce(int timeoutMs=10);
+
+    /**
+     * @brief Run the loop until stop() is called
+     */
+    void run();
+
+    /**
+     * @brief Make run() return
+     */
+    void stop();
+
+    /**
+     * @brief Get number of queued and in-flight requests
+     *
+     * @return Number of requests
+     */
+    int pending() const;
+
+    /**
+     * @brief Set a fixed reply timeout instead of the retry policy timeout
+     *
+     * @param timeoutMs Timeout in milli seconds, 0 to use the retry policy
+     */
+    void setReplyTimeout(int timeoutMs);
+
+    private:
+    /** @brief Bus state */
+    struct Bus {
+        CCTalk *cct;
+        CCTalkCommandQueue queue;
+        CCTalkCommandQueue::Command inflight;
+        bool busy;
+        bool backoff;           // Waiting after a BUSY reply until deadline
+        bool removed;           // Dropped by removeBus(), erased when no loop walks the buses
+        int attempt;            // Transmissions of the in-flight request
+        std::chrono::steady_clock::time_point sent;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    /**
+     * @brief Transmit the next queued request on a bus if it is idle
+     *
+     * @param bus Bus state
+     * @return Number of requests that failed while starting
+     */
+    int startNext(Bus &bus);
+
+    /**
+     * @brief Collect the reply of the in-flight request, retrying as the retry policy allows
+     *
+     * @param bus Bus state
+     * @return 1 if the request completed, 0 while pending
+     */
+    int serviceBus(Bus &bus);
+
+    /**
+     * @brief Send the in-flight request again, as the same bytes
+     *
+     * @param bus Bus state
+     * @return 1 if the request completed because transmitting failed, 0 otherwise
+     */
+    int resend(Bus &bus);
+
+    /**
+     * @brief Reply timeout of the in-flight request
+     *
+     * @param bus Bus state
+     * @return Timeout
+     */
+    std::chrono::milliseconds replyTimeout(Bus &bus) const;
+
+    /**
+     * @brief Erase removed buses when no loop is walking them
+     */
+    void purge();
+
+    /**
+     * @brief Complete the in-flight request of a bus
+     *
+     * @param bus Bus state
+     * @param result Result code
+     * @param reply Reply object
+     */
+    void complete(Bus &bus, int result, CCTalkPackage &reply);
+
+    /**
+     * @brief Wait until one of the busy buses has data
+     *
+     * @param timeoutMs Max time to wait in milli seconds
+     */
+    void waitForData(int timeoutMs);
+
+    private:
+    std::deque<Bus> _buses;
+    std::chrono::milliseconds _replyTimeout;
+    bool _running;
+    int _walking;       // Nesting depth of loops over _buses, removals wait for 0
+};
+
+#endif //_CCTALK_EVENTLOOP_H_
@@ -15,7 +15,8 @@
 #include <iostream>
 
 /**
- * @brief ccTalk package format
+ * @brief ccTalk package format.
+ * Data and the byte array live in the object, no memory is allocated per frame.
   */
 class CCTalkPackage {
     public:
@@ -23,15 +24,10 @@ class CCTalkPackage {
     /**
      * @brief Construct a new CCTalkPackage object
      */
-    CCTalkPackage(): data(nullptr), _buffer(nullptr){}
+    CCTalkPackage(): length(0), data(_data){}
 
-    /**
-     * @brief Destroy the CCTalkPackage object
-     */
-    ~CCTalkPackage(){
-        if(data != nullptr) delete [] data;
-        if(_buffer != nullptr) delete [] _buffer;
-    }
+    CCTalkPackage(const CCTalkPackage &) = delete;
+    CCTalkPackage &operator=(const CCTalkPackage &) = delete;
 
     /**
      * @brief Convert package object to a byte array
@@ -42,9 +38,6 @@ class CCTalkPackage {
     uint8_t* toBytearray(){
         int pos = 0;
 
-        if(_buffer != nullptr) delete [] _buffer;
-        _buffer = new uint8_t[length + 5];
-
         _buffer[pos++]=receiverID;
         _buffer[pos++]=length;
         _buffer[pos++]=senderID;
@@ -68,13 +61,14 @@ class CCTalkPackage {
     uint8_t senderID;
     /** @brief Package header / command */
     uint8_t header;
-    /** @brief Data container */
-    uint8_t *data;
+    /** @brief Data container, always points to the package's own storage */
+    uint8_t * const data;
     /** @brief Package crc/lrc value */
     uint8_t crc;
 
     private:
-    uint8_t *_buffer;
+    uint8_t _data[255];
+    uint8_t _buffer[255 + 5];
 };
 
 #endif //_CCTALK_PACKAGE_H_
\ No newline at end of file
@@ -0,0 +1,130 @@
+/**
+ * @file cctalkparser.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Streaming CCTalk frame parser with echo removal and resynchronization
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include "cctalkparser.h"
+#include <string.h>
+
+/** @brief Frame bytes besides the data: dest, len, src, header, checksum */
+static const int FrameOverhead = 5;
+
+/** @brief Reply headers: ACK / return message, NAK and BUSY */
+static const uint8_t ReplyAck = 0;
+static const uint8_t ReplyNak = 5;
+static const uint8_t ReplyBusy = 6;
+
+CCTalkParser::CCTalkParser() : _address(0), _source(0), _discarded(0){
+    reset();
+}
+
+void CCTalkParser::reset(){
+    _start = 0;
+    _end = 0;
+    _sum[0] = 0;
+    _echoLen = 0;
+    _echoPos = 0;
+    _source = 0;
+    _replyLimit = MaxFrameSize - FrameOverhead;
+}
+
+void CCTalkParser::setLocalAddress(const uint8_t address){
+    _address = address;
+}
+
+void CCTalkParser::expectEcho(const uint8_t *frame, const int len){
+    _echoLen = (len > MaxFrameSize) ? MaxFrameSize : len;
+    _echoPos = 0;
+    memcpy(_echo, frame, _echoLen);
+    _source = (_echoLen > 0) ? frame[0] : 0;    // 0 is broadcast, any device may answer
+}
+
+void CCTalkParser::setReplyLimit(const int len){
+    _replyLimit = len;
+}
+
+int CCTalkParser::space() const {
+    return BufferSize - (_end - _start);
+}
+
+void CCTalkParser::compact(){
+    if(_start == 0) return;
+    const int n_count = _end - _start;
+    const uint8_t n_base = _sum[_start];
+    memmove(_bffr, &_bffr[_start], n_count);
+    for(int n_index = 0; n_index <= n_count; n_index++) _sum[n_index] = (uint8_t)(_sum[_start + n_index] - n_base);
+    _start = 0;
+    _end = n_count;
+}
+
+int CCTalkParser::push(const uint8_t *data, const int len){
+    if(BufferSize - _end < len) compact();
+    const int n_take = (BufferSize - _end < len) ? BufferSize - _end : len;
+    for(int n_index = 0; n_index < n_take; n_index++) {
+        _bffr[_end] = data[n_index];
+        _sum[_end + 1] = (uint8_t)(_sum[_end] + data[n_index]);
+        _end++;
+    }
+    return n_take;
+}
+
+int CCTalkParser::frameAt(const int pos, int &len) const {
+    const uint8_t n_header = _bffr[pos + 3];
+    if((_address != 0 && _bffr[pos] != _address) ||
+       (_source != 0 && _bffr[pos + 2] != _source) ||
+       (n_header != ReplyAck && n_header != ReplyNak && n_header != ReplyBusy) ||
+       _bffr[pos + 1] > _replyLimit) return -1;
+
+    len = _bffr[pos + 1] + FrameOverhead;
+    if(_end - pos < len) return 0;
+    return ((uint8_t)(_sum[pos + len] - _sum[pos]) == 0) ? 1 : -1;
+}
+
+int CCTalkParser::next(uint8_t *frame){
+    while(true) {
+        // Local echo of the last transmitted frame
+        while(_echoPos < _echoLen && _start < _end) {
+            if(_bffr[_start] != _echo[_echoPos]) {
+                _echoLen = 0;   // Echo corrupted or missing, hunt for the reply instead
+                break;
+            }
+            _start++;
+            _echoPos++;
+        }
+        if(_echoPos < _echoLen) return 0;
+
+        if(_end - _start < 4) return 0;
+
+        int n_len = 0;
+        int n_res = frameAt(_start, n_len);
+        if(n_res < 0) {
+            _start++;
+            _discarded++;
+            continue;
+        }
+        if(n_res == 0) {
+            // Noise that looks like the start of a long frame, skip it if a
+            // complete reply already follows
+            int n_pos = _start + 1;
+            int n_next = 0;
+            while(n_pos + 4 <= _end && frameAt(n_pos, n_next) != 1) n_pos++;
+            if(n_pos + 4 > _end) return 0;
+            _discarded += n_pos - _start;
+            _start = n_pos;
+            continue;
+        }
+
+        memcpy(frame, &_bffr[_start], n_len);
+        _start += n_len;
+        if(_start == _end) {
+            _start = _end = 0;
+            _sum[0] = 0;
+        }
+        return n_len;
+    }
+}
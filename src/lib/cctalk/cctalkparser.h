@@ -0,0 +1,127 @@
+/**
+ * @file cctalkparser.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Streaming CCTalk frame parser with echo removal and resynchronization
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _CCTALK_PARSER_H_
+#define _CCTALK_PARSER_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Splits the receive byte stream into frames.
+ * The bus is a single wire, so every transmitted frame comes back as echo first.
+ * The echo is compared byte by byte and removed. After that the parser hunts for a
+ * reply in [dest][len][src][header][data][checksum]: dest must be the local address,
+ * src the device the request went to, the header ACK, NAK or BUSY and the sum of
+ * all bytes 0. A byte that can't start a frame is dropped, so a lost or corrupted
+ * byte costs at most one frame. Lengths above the longest reply of the request are
+ * rejected, and a candidate still waiting for bytes is dropped as soon as a complete
+ * valid frame follows it, so noise can't hold back a reply that already arrived.
+ *
+ * Checksums are checked with running prefix sums, so checking a candidate costs
+ * a constant number of operations.
+ */
+class CCTalkParser {
+    public:
+    static const int MaxFrameSize = 260;
+    static const int BufferSize = 2 * MaxFrameSize;
+
+    public:
+    CCTalkParser();
+
+    /**
+     * @brief Drop all buffered bytes and any expected echo
+     */
+    void reset();
+
+    /**
+     * @brief Set the address replies must be sent to
+     *
+     * @param address Local address, 0 accepts any
+     */
+    void setLocalAddress(const uint8_t address);
+
+    /**
+     * @brief Set the bytes just transmitted, they are removed when echoed back.
+     * Replies are only accepted from the device the frame was sent to.
+     *
+     * @param frame Frame as sent on the wire
+     * @param len Frame length
+     */
+    void expectEcho(const uint8_t *frame, const int len);
+
+    /**
+     * @brief Set the longest reply data expected, used until the next reset()
+     *
+     * @param len Number of data bytes
+     */
+    void setReplyLimit(const int len);
+
+    /**
+     * @brief Add received bytes
+     *
+     * @param data Received data
+     * @param len Number of bytes
+     * @return Number of bytes taken, less than len if the buffer is full
+     */
+    int push(const uint8_t *data, const int len);
+
+    /**
+     * @brief Get the number of free bytes in the buffer
+     *
+     * @return Free space
+     */
+    int space() const;
+
+    /**
+     * @brief Get the next complete frame
+     *
+     * @param frame Buffer of at least MaxFrameSize bytes
+     * @return Frame length, 0 if more data is needed
+     */
+    int next(uint8_t *frame);
+
+    /**
+     * @brief Get the number of bytes dropped while hunting for frames
+     *
+     * @return Byte count
+     */
+    uint32_t getDiscarded() const { return _discarded; }
+
+    private:
+    /**
+     * @brief Move the pending bytes to the start of the buffer
+     */
+    void compact();
+
+    /**
+     * @brief Check for a reply starting at a buffer position
+     *
+     * @param pos Buffer position
+     * @param len Reference to the frame length, set when the header bytes are valid
+     * @return 1 if a complete valid frame starts here, 0 if more bytes are needed to tell
+     * and -1 if no frame starts here
+     */
+    int frameAt(const int pos, int &len) const;
+
+    private:
+    uint8_t _bffr[BufferSize];
+    uint8_t _sum[BufferSize + 1];   // _sum[n] = sum of _bffr[0..n) mod 256
+    int _start;
+    int _end;
+    uint8_t _echo[MaxFrameSize];
+    int _echoLen;
+    int _echoPos;
+    uint8_t _address;
+    uint8_t _source;
+    int _replyLimit;
+    uint32_t _discarded;
+};
+
+#endif //_CCTALK_PARSER_H_
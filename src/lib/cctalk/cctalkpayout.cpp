@@ -0,0 +1,275 @@
+/**
+ * @file cctalkpayout.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Hopper payout engine for CCTalk
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include "cctalkpayout.h"
+#include "cctalkcommands.h"
+#include <unistd.h>
+#include <random>
+
+/** @brief EnableHopper data value that enables the hopper */
+static const uint8_t HopperEnableCode = 165;
+/** @brief Max coins in one DispenseHopperCoins command */
+static const uint32_t MaxBatch = 255;
+
+CCTalkPayout::CCTalkPayout(CCTalk &cct) : _cct(cct), _statusInterval(20){ }
+
+CCTalkPayout::~CCTalkPayout(){ }
+
+int CCTalkPayout::addHopper(const uint8_t address, const bool encrypted){
+    if(find(address) != nullptr) return -1;
+
+    CCTalkCommands::Counter24Reply n_serial;
+    if(CCTalkCommands::request<CCTalk::Header::RequestSerialNo>(_cct, address, n_serial) != 0) return -1;
+    CCTalkCommands::HopperStatusReply n_status;
+    if(CCTalkCommands::request<CCTalk::Header::RequestHopperStatus>(_cct, address, n_status) != 0) return -1;
+
+    Hopper n_hopper;
+    n_hopper.address = address;
+    n_hopper.encrypted = encrypted;
+    n_hopper.serialNo[0] = (uint8_t)(n_serial.value & 0xFF);
+    n_hopper.serialNo[1] = (uint8_t)((n_serial.value >> 8) & 0xFF);
+    n_hopper.serialNo[2] = (uint8_t)((n_serial.value >> 16) & 0xFF);
+    n_hopper.queued = 0;
+    n_hopper.batch = 0;
+    n_hopper.batchPaid = 0;
+    n_hopper.eventCounter = n_status.eventCounter;
+    n_hopper.unconfirmed = false;
+    n_hopper.progress.address = address;
+    _hoppers.push_back(n_hopper);
+    return 0;
+}
+
+int CCTalkPayout::dispense(const uint8_t address, const uint32_t count){
+    Hopper *n_hopper = find(address);
+    if(n_hopper == nullptr) return -1;
+    if(n_hopper->progress.state != State::Dispensing) {
+        n_hopper->progress.requested = 0;
+        n_hopper->progress.paid = 0;
+        n_hopper->progress.unpaid = 0;
+    }
+    n_hopper->queued += count;
+    n_hopper->progress.requested += count;
+    return 0;
+}
+
+int CCTalkPayout::startBatch(Hopper &hopper){
+    uint8_t n_data[9];
+    uint8_t n_length = 0;
+    CCTalkCommands::EmptyReply n_empty;
+    CCTalkPackage n_recvPack;
+
+    hopper.batch = (uint8_t)((hopper.queued > MaxBatch) ? MaxBatch : hopper.queued);
+
+    if(CCTalkCommands::request<CCTalk::Header::EnableHopper>(_cct, hopper.address, &HopperEnableCode, 1, n_empty) != 0)
+        return -1;
+
+    if(hopper.encrypted) {
+        if(!_cipherCallback) return -1;
+
+        static std::mt19937 n_rng(std::random_device{}());
+        uint8_t n_random[8];
+        for(int n_index = 0; n_index < 8; n_index++) n_random[n_index] = (uint8_t)(n_rng() & 0xFF);
+        if(CCTalkCommands::request<CCTalk::Header::PumpRNG>(_cct, hopper.address, n_random, 8, n_empty) != 0)
+            return -1;
+
+        CCTalkCommands::BytesReply<8> n_key;
+        if(CCTalkCommands::request<CCTalk::Header::RequestCipherKey>(_cct, hopper.address, n_key) != 0)
+            return -1;
+        if(_cipherCallback(hopper.address, n_key.bytes, n_data) != 0) return -1;
+        n_length = 8;
+    } else {
+        n_data[0] = hopper.serialNo[0];
+        n_data[1] = hopper.serialNo[1];
+        n_data[2] = hopper.serialNo[2];
+        n_length = 3;
+    }
+    n_data[n_length++] = hopper.batch;
+
+    int n_res = _cct.sendCommand(hopper.address, CCTalk::Header::DispenseHopperCoins, n_data, n_length, n_recvPack);
+    if(n_res == -1) {
+        // Only the reply may be lost and the hopper paying out, the event counter tells
+        hopper.unconfirmed = true;
+        setState(hopper, State::Dispensing);
+        return confirmBatch(hopper);
+    }
+    if(n_res != 0) return -1;
+
+    batchStarted(hopper);
+    return 0;
+}
+
+int CCTalkPayout::confirmBatch(Hopper &hopper){
+    CCTalkCommands::HopperStatusReply n_status;
+    hopper.nextPoll = std::chrono::steady_clock::now() + _statusInterval;
+    if(CCTalkCommands::request<CCTalk::Header::RequestHopperStatus>(_cct, hopper.address, n_status) != 0)
+        return 1;
+
+    hopper.unconfirmed = false;
+    const uint8_t n_expected = (hopper.eventCounter == 255) ? 1 : hopper.eventCounter + 1;
+    if(n_status.eventCounter != n_expected) return -1;
+    batchStarted(hopper);
+    return 0;
+}
+
+void CCTalkPayout::batchStarted(Hopper &hopper){
+    // The hopper event counter skips 0 when it wraps
+    hopper.eventCounter = (hopper.eventCounter == 255) ? 1 : hopper.eventCounter + 1;
+    hopper.queued -= hopper.batch;
+    hopper.batchPaid = 0;
+    hopper.unconfirmed = false;
+    hopper.nextPoll = std::chrono::steady_clock::now() + _statusInterval;
+    setState(hopper, State::Dispensing);
+}
+
+void CCTalkPayout::failBatch(Hopper &hopper){
+    hopper.progress.unpaid += hopper.queued;
+    hopper.queued = 0;
+    hopper.unconfirmed = false;
+    setState(hopper, State::Failed);
+}
+
+int CCTalkPayout::pollStatus(Hopper &hopper){
+    int n_res = 0;
+    if(hopper.unconfirmed) {
+        n_res = confirmBatch(hopper);
+        if(n_res == 0) return 0;
+        if(n_res > 0) return -1;
+        failBatch(hopper);
+        return -1;
+    }
+
+    CCTalkCommands::HopperStatusReply n_status;
+    hopper.nextPoll = std::chrono::steady_clock::now() + _statusInterval;
+    if(CCTalkCommands::request<CCTalk::Header::RequestHopperStatus>(_cct, hopper.address, n_status) != 0)
+        return -1;
+
+    // Not started on the new batch yet
+    if(n_status.eventCounter != hopper.eventCounter) return 0;
+
+    while(hopper.batchPaid < n_status.paid) {
+        hopper.batchPaid++;
+        hopper.progress.paid++;
+        if(_progressCallback) _progressCallback(hopper.progress);
+    }
+
+    if(n_status.remaining > 0) return 0;
+
+    if(n_status.unpaid > 0) {
+        // Hopper ran empty or jammed, the rest can't be paid either
+        hopper.progress.unpaid += n_status.unpaid + hopper.queued;
+        hopper.queued = 0;
+        setState(hopper, State::Failed);
+    } else if(hopper.queued > 0) {
+        n_res = startBatch(hopper);
+        if(n_res == 0) return 0;
+        if(n_res > 0) return -1;
+        failBatch(hopper);
+        n_res = -1;
+    } else {
+        setState(hopper, State::Done);
+    }
+
+    const uint8_t n_disable = 0;
+    CCTalkCommands::EmptyReply n_empty;
+    CCTalkCommands::request<CCTalk::Header::EnableHopper>(_cct, hopper.address, &n_disable, 1, n_empty);
+    return n_res;
+}
+
+int CCTalkPayout::service(){
+    int n_busy = 0;
+    int n_return = 0;
+
+    for(Hopper &n_hopper : _hoppers) {
+        if(n_hopper.progress.state == State::Dispensing || n_hopper.queued == 0) continue;
+        // Unconfirmed batches stay Dispensing and are checked again by pollStatus()
+        int n_res = startBatch(n_hopper);
+        if(n_res < 0) failBatch(n_hopper);
+        if(n_res != 0) n_return = -1;
+    }
+
+    auto n_now = std::chrono::steady_clock::now();
+    for(Hopper &n_hopper : _hoppers) {
+        if(n_hopper.progress.state != State::Dispensing) continue;
+        if(n_now >= n_hopper.nextPoll && pollStatus(n_hopper) != 0) n_return = -1;
+        if(n_hopper.progress.state == State::Dispensing) n_busy++;
+    }
+    return (n_return != 0) ? n_return : n_busy;
+}
+
+int CCTalkPayout::run(const int timeoutMs){
+    const auto n_end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    int n_errors = 0;
+
+    while(true) {
+        int n_res = service();
+        if(n_res < 0) {
+            // A lost reply is retried on the next poll, give up if the bus stays silent
+            if(++n_errors > 10) return -1;
+        } else {
+            n_errors = 0;
+            if(n_res == 0) return 0;
+        }
+        if(std::chrono::steady_clock::now() > n_end) return -2;
+        usleep(1000);
+    }
+}
+
+int CCTalkPayout::emergencyStop(){
+    int n_return = 0;
+    for(Hopper &n_hopper : _hoppers) {
+        CCTalkCommands::ByteReply n_unpaid;
+        if(CCTalkCommands::request<CCTalk::Header::EmergencyStop>(_cct, n_hopper.address, n_unpaid) != 0) {
+            n_return = -1;
+            continue;
+        }
+        // An unacknowledged batch is counted once, in the hopper's unpaid count or in queued
+        if(n_hopper.unconfirmed) confirmBatch(n_hopper);
+        if(n_hopper.progress.state == State::Dispensing || n_hopper.queued > 0) {
+            n_hopper.progress.unpaid += n_unpaid.value + n_hopper.queued;
+            n_hopper.queued = 0;
+            setState(n_hopper, State::Failed);
+        }
+    }
+    return n_return;
+}
+
+int CCTalkPayout::getProgress(const uint8_t address, Progress &progress) const {
+    for(const Hopper &n_hopper : _hoppers) {
+        if(n_hopper.address != address) continue;
+        progress = n_hopper.progress;
+        return 0;
+    }
+    return -1;
+}
+
+void CCTalkPayout::setProgressCallback(ProgressCallback callback){
+    _progressCallback = callback;
+}
+
+void CCTalkPayout::setCipherCallback(CipherCallback callback){
+    _cipherCallback = callback;
+}
+
+void CCTalkPayout::setStatusInterval(const int intervalMs){
+    _statusInterval = std::chrono::milliseconds(intervalMs);
+}
+
+void CCTalkPayout::setState(Hopper &hopper, const State state){
+    if(hopper.progress.state == state) return;
+    hopper.progress.state = state;
+    if(_progressCallback) _progressCallback(hopper.progress);
+}
+
+CCTalkPayout::Hopper *CCTalkPayout::find(const uint8_t address){
+    for(Hopper &n_hopper : _hoppers) {
+        if(n_hopper.address == address) return &n_hopper;
+    }
+    return nullptr;
+}
@@ -0,0 +1,209 @@
+/**
+ * @file cctalkpayout.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Hopper payout engine for CCTalk
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _CCTALK_PAYOUT_H_
+#define _CCTALK_PAYOUT_H_
+
+#include "cctalk.h"
+#include <chrono>
+#include <functional>
+#include <vector>
+
+/**
+ * @brief Runs payouts on one or more hoppers on the same bus.
+ * Every hopper with work is started first, after that the status polls of all
+ * running hoppers are interleaved, so the hoppers pay out at the same time
+ * instead of one after the other.
+ */
+class CCTalkPayout {
+    public:
+    /** @brief Payout state of a hopper */
+    enum class State {
+        Idle        = 0,
+        Dispensing  = 1,
+        Done        = 2,
+        Failed      = 3
+    };
+
+    /** @brief Progress report */
+    class Progress {
+        public:
+        Progress() : address(0), requested(0), paid(0), unpaid(0), state(State::Idle){}
+        uint8_t address;
+        uint32_t requested;     // Coins requested in total
+        uint32_t paid;          // Coins paid so far
+        uint32_t unpaid;        // Coins that could not be paid (ie. hopper empty)
+        State state;
+    };
+
+    /**
+     * @brief Progress callback, called for every coin paid and on state changes
+     */
+    typedef std::function<void(const Progress &progress)> ProgressCallback;
+
+    /**
+     * @brief Cipher callback for encrypted hoppers.
+     * Turns the key returned by RequestCipherKey into the 8 byte dispense code.
+     * Returns 0 on success.
+     */
+    typedef std::function<int(const uint8_t address, const uint8_t key[8], uint8_t code[8])> CipherCallback;
+
+    public:
+    CCTalkPayout(CCTalk &cct);
+    ~CCTalkPayout();
+
+    /**
+     * @brief Add a hopper, reads its serial number
+     *
+     * @param address Hopper address
+     * @param encrypted Hopper uses the cipher key dispense sequence
+     * @return Success
+     */
+    int addHopper(const uint8_t address, const bool encrypted=false);
+
+    /**
+     * @brief Queue coins for payout
+     *
+     * @param address Hopper address
+     * @param count Number of coins
+     * @return Success
+     */
+    int dispense(const uint8_t address, const uint32_t count);
+
+    /**
+     * @brief Start waiting hoppers and poll the running ones once each
+     *
+     * @return Number of hoppers still busy or -1 on error
+     */
+    int service();
+
+    /**
+     * @brief Call service() until all hoppers are done
+     *
+     * @param timeoutMs Give up after this time
+     * @return Success, -2 on timeout
+     */
+    int run(const int timeoutMs);
+
+    /**
+     * @brief Stop all hoppers
+     *
+     * @return Success
+     */
+    int emergencyStop();
+
+    /**
+     * @brief Get the progress of a hopper
+     *
+     * @param address Hopper address
+     * @param progress Reference to the progress object
+     * @return Success
+     */
+    int getProgress(const uint8_t address, Progress &progress) const;
+
+    /**
+     * @brief Set the Progress Callback object
+     *
+     * @param callback Callback function
+     */
+    void setProgressCallback(ProgressCallback callback);
+
+    /**
+     * @brief Set the Cipher Callback object, required for encrypted hoppers
+     *
+     * @param callback Callback function
+     */
+    void setCipherCallback(CipherCallback callback);
+
+    /**
+     * @brief Set the minimum time between status polls of the same hopper
+     *
+     * @param intervalMs Interval in milli seconds
+     */
+    void setStatusInterval(const int intervalMs);
+
+    private:
+    /** @brief Hopper state */
+    struct Hopper {
+        uint8_t address;
+        bool encrypted;
+        uint8_t serialNo[3];
+        uint32_t queued;        // Coins not yet handed to the hopper
+        uint8_t batch;          // Coins in the running dispense command
+        uint8_t batchPaid;      // Coins of the running batch already reported
+        uint8_t eventCounter;
+        bool unconfirmed;       // Dispense sent but not acknowledged, not known if the batch started
+        Progress progress;
+        std::chrono::steady_clock::time_point nextPoll;
+    };
+
+    /**
+     * @brief Send the dispense sequence for the next batch
+     *
+     * @param hopper Hopper state
+     * @return Success, -1 if the batch didn't start, 1 if that isn't known yet
+     */
+    int startBatch(Hopper &hopper);
+
+    /**
+     * @brief Check with the hopper event counter if an unacknowledged batch started
+     *
+     * @param hopper Hopper state
+     * @return Success if it started, -1 if it didn't, 1 if the status couldn't be read
+     */
+    int confirmBatch(Hopper &hopper);
+
+    /**
+     * @brief Book the batch as handed to the hopper
+     *
+     * @param hopper Hopper state
+     */
+    void batchStarted(Hopper &hopper);
+
+    /**
+     * @brief Book the coins not handed to the hopper as unpaid and mark it failed
+     *
+     * @param hopper Hopper state
+     */
+    void failBatch(Hopper &hopper);
+
+    /**
+     * @brief Poll hopper status and report progress
+     *
+     * @param hopper Hopper state
+     * @return Success
+     */
+    int pollStatus(Hopper &hopper);
+
+    /**
+     * @brief Change state and report it
+     *
+     * @param hopper Hopper state
+     * @param state New state
+     */
+    void setState(Hopper &hopper, const State state);
+
+    /**
+     * @brief Find a hopper by address
+     *
+     * @param address Hopper address
+     * @return Pointer to hopper or nullptr
+     */
+    Hopper *find(const uint8_t address);
+
+    private:
+    CCTalk &_cct;
+    std::vector<Hopper> _hoppers;
+    ProgressCallback _progressCallback;
+    CipherCallback _cipherCallback;
+    std::chrono::milliseconds _statusInterval;
+};
+
+#endif //_CCTALK_PAYOUT_H_
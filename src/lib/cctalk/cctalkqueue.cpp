@@ -0,0 +1,109 @@
+/**
+ * @file cctalkqueue.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief CCTalk command queue with priority lanes
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include "cctalkqueue.h"
+
+CCTalkCommandQueue::CCTalkCommandQueue() : _backgroundShare(8), _passed(0){ }
+
+void CCTalkCommandQueue::push(Command &&command){
+    _lanes[(int)command.priority].push_back(std::move(command));
+}
+
+int CCTalkCommandQueue::pop(Command &command){
+    const int n_background = (int)Priority::Background;
+    int n_lane = -1;
+
+    if(!_lanes[n_background].empty() && _backgroundShare > 0 && _passed >= _backgroundShare) {
+        n_lane = n_background;
+    } else {
+        for(int n_index = 0; n_index < LaneCount; n_index++) {
+            if(!_lanes[n_index].empty()) {
+                n_lane = n_index;
+                break;
+            }
+        }
+    }
+    if(n_lane < 0) return -1;
+
+    if(n_lane == n_background) _passed = 0;
+    else if(!_lanes[n_background].empty()) _passed++;
+
+    command = std::move(_lanes[n_lane].front());
+    _lanes[n_lane].pop_front();
+    return 0;
+}
+
+bool CCTalkCommandQueue::empty() const {
+    for(int n_index = 0; n_index < LaneCount; n_index++) {
+        if(!_lanes[n_index].empty()) return false;
+    }
+    return true;
+}
+
+int CCTalkCommandQueue::size() const {
+    int n_count = 0;
+    for(int n_index = 0; n_index < LaneCount; n_index++) n_count += (int)_lanes[n_index].size();
+    return n_count;
+}
+
+int CCTalkCommandQueue::size(Priority priority) const {
+    return (int)_lanes[(int)priority].size();
+}
+
+void CCTalkCommandQueue::clear(int result){
+    CCTalkPackage n_empty;
+    n_empty.length = 0;
+    Command n_command;
+    while(pop(n_command) == 0) {
+        if(n_command.callback) n_command.callback(result, n_empty);
+    }
+    _passed = 0;
+}
+
+void CCTalkCommandQueue::setBackgroundShare(int count){
+    _backgroundShare = count;
+}
+
+CCTalkCommandQueue::Priority CCTalkCommandQueue::defaultPriority(CCTalk::Header header){
+    switch (header)
+    {
+    case CCTalk::Header::SimplePoll:
+    case CCTalk::Header::ReadBuffCreditOrErr:
+    case CCTalk::Header::ReadEncryptedEvents:
+        return Priority::Critical;
+
+    case CCTalk::Header::RequestManufactId:
+    case CCTalk::Header::RequestEquiptCatId:
+    case CCTalk::Header::RequestProductCode:
+    case CCTalk::Header::RequestDatabaseVer:
+    case CCTalk::Header::RequestSerialNo:
+    case CCTalk::Header::RequestSoftwareVer:
+    case CCTalk::Header::RequestBuildCode:
+    case CCTalk::Header::RequestCreationDate:
+    case CCTalk::Header::RequestLastModifyDate:
+    case CCTalk::Header::RequestBaseYear:
+    case CCTalk::Header::RequestCommsRevision:
+    case CCTalk::Header::RequestCommsStatusVariables:
+    case CCTalk::Header::RequestInsertionCounter:
+    case CCTalk::Header::RequestAcceptCounter:
+    case CCTalk::Header::RequestRejectCounter:
+    case CCTalk::Header::RequestFraudCounter:
+    case CCTalk::Header::RequestAlarmCounter:
+    case CCTalk::Header::RequestAuditInfoBlock:
+    case CCTalk::Header::RequestCoinId:
+    case CCTalk::Header::RequestDataStorageAvail:
+    case CCTalk::Header::ReadDataBlock:
+    case CCTalk::Header::RequestThremistorRead:
+        return Priority::Background;
+
+    default:
+        return Priority::High;
+    }
+}
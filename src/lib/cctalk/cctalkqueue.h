@@ -0,0 +1,123 @@
+/**
+ * @file cctalkqueue.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief CCTalk command queue with priority lanes
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _CCTALK_QUEUE_H_
+#define _CCTALK_QUEUE_H_
+
+#include "cctalk.h"
+#include <deque>
+#include <vector>
+#include <functional>
+
+/**
+ * @brief Per bus command queue.
+ * Commands are taken from the most urgent non-empty lane. To keep bulk reads
+ * moving, a waiting background command is let through after a configurable
+ * number of more urgent commands.
+ */
+class CCTalkCommandQueue {
+    public:
+    /** @brief Priority lanes, most urgent first */
+    enum class Priority {
+        Critical    = 0, /*!< Event polls, credit latency depends on these */
+        High        = 1, /*!< Payout and control commands */
+        Background  = 2  /*!< Audit and identification requests */
+    };
+
+    /** @brief Number of priority lanes */
+    static const int LaneCount = 3;
+
+    /**
+     * @brief Completion callback
+     *
+     * Result codes are those of CCTalk::sendCommand(): 0 on success, -1 on timeout or
+     * transmission error, -2 if the device answered NAK and -3 if it stayed BUSY.
+     * The reply object is only valid during the callback.
+     */
+    typedef std::function<void(int result, CCTalkPackage &reply)> Callback;
+
+    /** @brief Queued command */
+    struct Command {
+        uint8_t receiverID;
+        uint8_t header;
+        std::vector<uint8_t> data;
+        Callback callback;
+        Priority priority;
+    };
+
+    public:
+    CCTalkCommandQueue();
+
+    /**
+     * @brief Add a command to its lane
+     *
+     * @param command Command to queue
+     */
+    void push(Command &&command);
+
+    /**
+     * @brief Take the next command to issue
+     *
+     * @param command Reference to command object to move the command into
+     * @return Success, -1 if the queue is empty
+     */
+    int pop(Command &command);
+
+    /**
+     * @brief Check if all lanes are empty
+     *
+     * @return Result
+     */
+    bool empty() const;
+
+    /**
+     * @brief Get number of queued commands
+     *
+     * @return Number of commands
+     */
+    int size() const;
+
+    /**
+     * @brief Get number of queued commands in one lane
+     *
+     * @param priority Lane to count
+     * @return Number of commands
+     */
+    int size(Priority priority) const;
+
+    /**
+     * @brief Remove all commands, calling their callbacks with the given result
+     *
+     * @param result Result passed to the callbacks
+     */
+    void clear(int result);
+
+    /**
+     * @brief Set how many urgent commands may pass a waiting background command
+     *
+     * @param count Number of commands, 0 gives background commands no share
+     */
+    void setBackgroundShare(int count);
+
+    /**
+     * @brief Get the default lane for a command header
+     *
+     * @param header Command header
+     * @return Priority
+     */
+    static Priority defaultPriority(CCTalk::Header header);
+
+    private:
+    std::deque<Command> _lanes[LaneCount];
+    int _backgroundShare;
+    int _passed;
+};
+
+#endif //_CCTALK_QUEUE_H_
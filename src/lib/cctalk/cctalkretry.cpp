@@ -0,0 +1,100 @@
+/**
+ * @file cctalkretry.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Per command retry policy with adaptive reply timeouts
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include "cctalkretry.h"
+#include "cctalk.h"
+#include <algorithm>
+
+/** @brief Longest BUSY wait */
+static const int MaxBusyBackoffMs = 500;
+
+CCTalkRetryPolicy::CCTalkRetryPolicy() : _defaultAttempts(3), _minTimeout(20), _maxTimeout(1000),
+                                         _factor(3.0), _busyBackoff(10), _trackerCount(0){
+    for(int n_index = 0; n_index < 256; n_index++) _attempts[n_index] = 0;
+    for(int n_index = 0; n_index < 256; n_index++) _tracker[n_index] = 0;
+
+    // Not safe to repeat when only the reply got lost
+    const CCTalk::Header n_once[] = {
+        CCTalk::Header::DispenseHopperCoins, CCTalk::Header::DispenseHopperValue,
+        CCTalk::Header::PayMoneyOut, CCTalk::Header::PurgeHopper, CCTalk::Header::EmptyPayout,
+        CCTalk::Header::PumpRNG, CCTalk::Header::RequestCipherKey, CCTalk::Header::SwitchEncryptionKey,
+        CCTalk::Header::SwitchBaudRate, CCTalk::Header::ResetDevice
+    };
+    for(CCTalk::Header n_header : n_once) _attempts[(uint8_t)n_header] = 1;
+}
+
+void CCTalkRetryPolicy::setDefaultAttempts(const int attempts){
+    _defaultAttempts = (attempts < 1) ? 1 : attempts;
+}
+
+void CCTalkRetryPolicy::setAttempts(const uint8_t header, const int attempts){
+    _attempts[header] = (attempts < 1) ? 1 : attempts;
+}
+
+int CCTalkRetryPolicy::getAttempts(const uint8_t header) const {
+    return (_attempts[header] > 0) ? _attempts[header] : _defaultAttempts;
+}
+
+void CCTalkRetryPolicy::setTimeout(const int minMs, const int maxMs, const double factor){
+    _minTimeout = minMs;
+    _maxTimeout = (maxMs < minMs) ? minMs : maxMs;
+    _factor = factor;
+}
+
+void CCTalkRetryPolicy::setBusyBackoff(const int busyMs){
+    _busyBackoff = busyMs;
+}
+
+int CCTalkRetryPolicy::getTimeout(const uint8_t header){
+    uint32_t n_p99 = getP99(header);
+    if(n_p99 == 0) return _maxTimeout;
+
+    int n_timeout = (int)((n_p99 * _factor) / 1000.0) + 1;
+    if(n_timeout < _minTimeout) return _minTimeout;
+    if(n_timeout > _maxTimeout) return _maxTimeout;
+    return n_timeout;
+}
+
+int CCTalkRetryPolicy::getBusyBackoff(const int attempt) const {
+    int n_wait = _busyBackoff << ((attempt > 6) ? 6 : attempt);
+    return (n_wait > MaxBusyBackoffMs) ? MaxBusyBackoffMs : n_wait;
+}
+
+void CCTalkRetryPolicy::addSample(const uint8_t header, const uint32_t latencyUs){
+    if(_tracker[header] == 0) {
+        if(_trackerCount == MaxTracked) return;
+        Tracker &n_new = _trackers[_trackerCount++];
+        n_new.count = 0;
+        n_new.next = 0;
+        n_new.p99 = 0;
+        _tracker[header] = (uint8_t)_trackerCount;
+    }
+    Tracker &n_tracker = _trackers[_tracker[header] - 1];
+    n_tracker.samples[n_tracker.next] = latencyUs;
+    n_tracker.next = (n_tracker.next + 1) % LatencySamples;
+    if(n_tracker.count < LatencySamples) n_tracker.count++;
+    n_tracker.dirty = true;
+}
+
+uint32_t CCTalkRetryPolicy::getP99(const uint8_t header){
+    if(_tracker[header] == 0) return 0;
+    Tracker &n_tracker = _trackers[_tracker[header] - 1];
+    if(n_tracker.count < MinSamples) return 0;
+
+    if(n_tracker.dirty) {
+        uint32_t n_sorted[LatencySamples];
+        std::copy(n_tracker.samples, n_tracker.samples + n_tracker.count, n_sorted);
+        int n_rank = (n_tracker.count * 99 + 99) / 100 - 1;
+        std::nth_element(n_sorted, n_sorted + n_rank, n_sorted + n_tracker.count);
+        n_tracker.p99 = n_sorted[n_rank];
+        n_tracker.dirty = false;
+    }
+    return n_tracker.p99;
+}
@@ -0,0 +1,131 @@
+/**
+ * @file cctalkretry.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Per command retry policy with adaptive reply timeouts
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _CCTALK_RETRY_H_
+#define _CCTALK_RETRY_H_
+
+#include <stdint.h>
+#include <inttypes.h>
+
+/**
+ * @brief Decides how often a command is sent and how long to wait for the reply.
+ * The reply latency of every header is tracked over the last LatencySamples replies,
+ * the timeout is the p99 latency times a factor, clamped to [min, max]. Until enough
+ * samples are collected the max timeout is used.
+ *
+ * Commands that change state in a way that isn't safe to repeat (dispensing, key
+ * changes, reset) are sent once by default.
+ */
+class CCTalkRetryPolicy {
+    public:
+    /** @brief Number of latency samples kept per header */
+    static const int LatencySamples = 64;
+    /** @brief Samples needed before the timeout adapts */
+    static const int MinSamples = 8;
+    /** @brief Number of headers tracked, further headers always use the max timeout */
+    static const int MaxTracked = 32;
+
+    public:
+    CCTalkRetryPolicy();
+
+    /**
+     * @brief Set the number of attempts used for all headers without an own setting
+     *
+     * @param attempts Number of transmissions, at least 1
+     */
+    void setDefaultAttempts(const int attempts);
+
+    /**
+     * @brief Set the number of attempts for one header
+     *
+     * @param header Command header
+     * @param attempts Number of transmissions, at least 1
+     */
+    void setAttempts(const uint8_t header, const int attempts);
+
+    /**
+     * @brief Get the number of attempts for a header
+     *
+     * @param header Command header
+     * @return Number of transmissions
+     */
+    int getAttempts(const uint8_t header) const;
+
+    /**
+     * @brief Set the timeout limits and the p99 factor
+     *
+     * @param minMs Lower limit in milli seconds
+     * @param maxMs Upper limit, also used until enough samples are collected
+     * @param factor p99 multiplier
+     */
+    void setTimeout(const int minMs, const int maxMs, const double factor);
+
+    /**
+     * @brief Set the wait before resending after a BUSY reply, doubled per retry
+     *
+     * @param busyMs Initial wait in milli seconds
+     */
+    void setBusyBackoff(const int busyMs);
+
+    /**
+     * @brief Get the reply timeout of a header
+     *
+     * @param header Command header
+     * @return Timeout in milli seconds
+     */
+    int getTimeout(const uint8_t header);
+
+    /**
+     * @brief Get the wait after a BUSY reply
+     *
+     * @param attempt Zero based attempt number
+     * @return Wait in milli seconds
+     */
+    int getBusyBackoff(const int attempt) const;
+
+    /**
+     * @brief Record the latency of a valid reply
+     *
+     * @param header Command header
+     * @param latencyUs Time from transmit to complete reply in micro seconds
+     */
+    void addSample(const uint8_t header, const uint32_t latencyUs);
+
+    /**
+     * @brief Get the p99 latency of a header
+     *
+     * @param header Command header
+     * @return Latency in micro seconds, 0 if not enough samples
+     */
+    uint32_t getP99(const uint8_t header);
+
+    private:
+    /** @brief Latency history of a header */
+    struct Tracker {
+        uint32_t samples[LatencySamples];   // Ring buffer
+        int count;
+        int next;
+        uint32_t p99;
+        bool dirty;
+    };
+
+    private:
+    int _defaultAttempts;
+    int _attempts[256];             // 0 = use default
+    int _minTimeout;
+    int _maxTimeout;
+    double _factor;
+    int _busyBackoff;
+    uint8_t _tracker[256];          // Index + 1 into _trackers, 0 = not tracked
+    Tracker _trackers[MaxTracked];  // Fixed, no allocation per sample
+    int _trackerCount;
+};
+
+#endif //_CCTALK_RETRY_H_
@@ -0,0 +1,128 @@
+/**
+ * @file cctalkscheduler.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Adaptive per device event poll scheduler
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include "cctalkscheduler.h"
+#include "cctalkcommands.h"
+
+/** @brief Default peak rate, a fast coin validator takes a few coins per second */
+static const double DefaultEventRate = 8.0;
+
+CCTalkPollScheduler::CCTalkPollScheduler() : _fastInterval(20), _activeHold(1000){ }
+
+CCTalkPollScheduler::~CCTalkPollScheduler(){ }
+
+int CCTalkPollScheduler::addDevice(const uint8_t address, const int maxIntervalMs){
+    if(find(address) != nullptr) return -1;
+    Device n_device;
+    n_device.address = address;
+    n_device.interval = _fastInterval;
+    n_device.maxInterval = (maxIntervalMs > _fastInterval) ? maxIntervalMs : _fastInterval;
+    n_device.eventRate = DefaultEventRate;
+    n_device.due = Clock::now();
+    n_device.lastEvent = Clock::time_point();
+    _devices.push_back(n_device);
+    return 0;
+}
+
+int CCTalkPollScheduler::pollPriorityToMs(const uint8_t units, const uint8_t value){
+    static const int n_unitMs[] = { 0, 1, 10, 1000, 60000 };
+    // 0 is special (see manual), hours and up aren't meaningful for event polling
+    if(units == 0 || value == 0) return 0;
+    if(units >= sizeof(n_unitMs) / sizeof(n_unitMs[0])) return 3600000;
+    return n_unitMs[units] * value;
+}
+
+int CCTalkPollScheduler::queryPollPriority(CCTalk &cct, const uint8_t address){
+    Device *n_device = find(address);
+    if(n_device == nullptr) return -1;
+
+    CCTalkCommands::PollPriorityReply n_reply;
+    if(CCTalkCommands::request<CCTalk::Header::RequestPollPriority>(cct, address, n_reply) != 0) return -1;
+    int n_ms = pollPriorityToMs(n_reply.units, n_reply.value);
+    if(n_ms > 0) n_device->maxInterval = (n_ms > _fastInterval) ? n_ms : _fastInterval;
+    return 0;
+}
+
+void CCTalkPollScheduler::setEventRate(const uint8_t address, const double eventsPerSecond){
+    Device *n_device = find(address);
+    if(n_device != nullptr && eventsPerSecond > 0) n_device->eventRate = eventsPerSecond;
+}
+
+void CCTalkPollScheduler::setFastInterval(const int intervalMs){
+    _fastInterval = (intervalMs > 0) ? intervalMs : 1;
+}
+
+void CCTalkPollScheduler::setActiveHold(const int holdMs){
+    _activeHold = holdMs;
+}
+
+int CCTalkPollScheduler::next(uint8_t &address){
+    if(_devices.empty()) return -1;
+
+    const Device *n_first = &_devices[0];
+    for(const Device &n_device : _devices) {
+        if(n_device.due < n_first->due) n_first = &n_device;
+    }
+    address = n_first->address;
+
+    auto n_wait = std::chrono::duration_cast<std::chrono::milliseconds>(n_first->due - Clock::now()).count();
+    return (n_wait > 0) ? (int)n_wait : 0;
+}
+
+int CCTalkPollScheduler::limit(const Device &device) const {
+    // Poll before the buffer can fill up at the peak rate
+    int n_window = (int)(EventBufferSize * 1000.0 / device.eventRate);
+    int n_limit = (device.maxInterval < n_window) ? device.maxInterval : n_window;
+    return (n_limit > _fastInterval) ? n_limit : _fastInterval;
+}
+
+void CCTalkPollScheduler::update(const uint8_t address, const int newEvents, const int lostEvents){
+    Device *n_device = find(address);
+    if(n_device == nullptr) return;
+    const Clock::time_point n_now = Clock::now();
+
+    if(lostEvents > 0) {
+        // The buffer overflowed within one interval, the peak rate was higher than assumed
+        double n_rate = (EventBufferSize + lostEvents) * 1000.0 / n_device->interval;
+        if(n_rate > n_device->eventRate) n_device->eventRate = n_rate;
+    }
+
+    if(newEvents > 0 || lostEvents > 0) {
+        n_device->lastEvent = n_now;
+        n_device->interval = _fastInterval;
+    } else if(n_now - n_device->lastEvent >= std::chrono::milliseconds(_activeHold)) {
+        n_device->interval += n_device->interval / 2 + 1;
+    }
+
+    int n_limit = limit(*n_device);
+    if(n_device->interval > n_limit) n_device->interval = n_limit;
+    n_device->due = n_now + std::chrono::milliseconds(n_device->interval);
+}
+
+void CCTalkPollScheduler::failed(const uint8_t address){
+    Device *n_device = find(address);
+    if(n_device == nullptr) return;
+    n_device->interval = limit(*n_device);
+    n_device->due = Clock::now() + std::chrono::milliseconds(n_device->interval);
+}
+
+int CCTalkPollScheduler::getInterval(const uint8_t address) const {
+    for(const Device &n_device : _devices) {
+        if(n_device.address == address) return n_device.interval;
+    }
+    return -1;
+}
+
+CCTalkPollScheduler::Device *CCTalkPollScheduler::find(const uint8_t address){
+    for(Device &n_device : _devices) {
+        if(n_device.address == address) return &n_device;
+    }
+    return nullptr;
+}
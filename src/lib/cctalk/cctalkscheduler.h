@@ -0,0 +1,157 @@
+/**
+ * @file cctalkscheduler.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Adaptive per device event poll scheduler
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _CCTALK_SCHEDULER_H_
+#define _CCTALK_SCHEDULER_H_
+
+#include "cctalk.h"
+#include <chrono>
+#include <vector>
+
+/**
+ * @brief Decides when each device's event buffer is read next.
+ * A device is polled at the fast interval while events arrive and for a hold time
+ * after the last one (a coin may still be in the coin path). After that the interval
+ * grows by half on every quiet poll, up to the slowest allowed interval:
+ *
+ *   max interval = min(advertised poll priority, overflow window)
+ *
+ * The overflow window is the time the device needs to fill its 5 event buffer at
+ * its peak event rate. Lost events increase the assumed peak rate, so the window
+ * shrinks and the device is polled faster from then on.
+ */
+class CCTalkPollScheduler {
+    public:
+    typedef std::chrono::steady_clock Clock;
+
+    /** @brief Events a device can buffer between two polls */
+    static const int EventBufferSize = 5;
+    /** @brief Slowest poll interval before the device told its own */
+    static const int DefaultMaxIntervalMs = 200;
+
+    public:
+    CCTalkPollScheduler();
+    ~CCTalkPollScheduler();
+
+    /**
+     * @brief Add a device, it is due right away
+     *
+     * @param address Device address
+     * @param maxIntervalMs Slowest poll interval until the poll priority is known
+     * @return Success
+     */
+    int addDevice(const uint8_t address, const int maxIntervalMs=DefaultMaxIntervalMs);
+
+    /**
+     * @brief Read the advertised poll interval (RequestPollPriority) and use it as upper limit
+     *
+     * @param cct CCTalk interface
+     * @param address Device address
+     * @return Success
+     */
+    int queryPollPriority(CCTalk &cct, const uint8_t address);
+
+    /**
+     * @brief Set the peak event rate of a device, it decides the overflow window
+     *
+     * @param address Device address
+     * @param eventsPerSecond Peak events per second
+     */
+    void setEventRate(const uint8_t address, const double eventsPerSecond);
+
+    /**
+     * @brief Set the interval used while a device is active
+     *
+     * @param intervalMs Interval in milli seconds
+     */
+    void setFastInterval(const int intervalMs);
+
+    /**
+     * @brief Set how long a device stays at the fast interval after its last event
+     *
+     * @param holdMs Time in milli seconds
+     */
+    void setActiveHold(const int holdMs);
+
+    /**
+     * @brief Get the device that is due first
+     *
+     * @param address Reference to device address
+     * @return Milli seconds until it is due (0 = now), -1 if there are no devices
+     */
+    int next(uint8_t &address);
+
+    /**
+     * @brief Report the result of a poll, the next poll time is set from it
+     *
+     * @param address Device address
+     * @param newEvents Number of new events read
+     * @param lostEvents Number of events the device dropped since the last poll
+     */
+    void update(const uint8_t address, const int newEvents, const int lostEvents=0);
+
+    /**
+     * @brief Report a poll that got no reply, the device is retried at the slow interval
+     *
+     * @param address Device address
+     */
+    void failed(const uint8_t address);
+
+    /**
+     * @brief Get the current poll interval of a device
+     *
+     * @param address Device address
+     * @return Interval in milli seconds, -1 for unknown devices
+     */
+    int getInterval(const uint8_t address) const;
+
+    /**
+     * @brief Convert a poll priority reply to milli seconds
+     *
+     * @param units Unit code
+     * @param value Value
+     * @return Interval in milli seconds, 0 if the device didn't give one
+     */
+    static int pollPriorityToMs(const uint8_t units, const uint8_t value);
+
+    private:
+    /** @brief Scheduling state of a device */
+    struct Device {
+        uint8_t address;
+        int interval;           // Current interval in ms
+        int maxInterval;        // Advertised / configured upper limit in ms
+        double eventRate;       // Assumed peak events per second
+        Clock::time_point due;
+        Clock::time_point lastEvent;
+    };
+
+    /**
+     * @brief Find a device
+     *
+     * @param address Device address
+     * @return Pointer to device or nullptr
+     */
+    Device *find(const uint8_t address);
+
+    /**
+     * @brief Slowest interval that can't overflow the event buffer
+     *
+     * @param device Device
+     * @return Interval in milli seconds
+     */
+    int limit(const Device &device) const;
+
+    private:
+    std::vector<Device> _devices;
+    int _fastInterval;
+    int _activeHold;
+};
+
+#endif //_CCTALK_SCHEDULER_H_
@@ -0,0 +1,217 @@
+/**
+ * @file cctalkshm.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief CCTalk device state and event export through POSIX shared memory
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include "cctalkshm.h"
+#include <string.h>
+#include <time.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
+static_assert((CCTalkSharedExport::RingSize & (CCTalkSharedExport::RingSize - 1)) == 0, "RingSize must be a power of two");
+
+CCTalkSharedExport::CCTalkSharedExport() : _layout(nullptr), _owner(false){ }
+
+CCTalkSharedExport::~CCTalkSharedExport(){
+    close();
+}
+
+int CCTalkSharedExport::create(const std::string name){
+#ifdef _WIN32
+    return -1;
+#else
+    close();
+    int n_fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if(n_fd < 0) return -1;
+    if(ftruncate(n_fd, sizeof(Layout)) != 0) {
+        ::close(n_fd);
+        return -1;
+    }
+    void *n_map = mmap(nullptr, sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, n_fd, 0);
+    ::close(n_fd);
+    if(n_map == MAP_FAILED) return -1;
+
+    // Readers check magic last, so clear it before the rest of the reset
+    _layout = (Layout*)n_map;
+    __atomic_store_n(&_layout->magic, 0, __ATOMIC_RELEASE);
+    memset((void*)&_layout->devices, 0, sizeof(_layout->devices));
+    memset((void*)&_layout->ring, 0, sizeof(_layout->ring));
+    _layout->deviceCount.store(0, std::memory_order_relaxed);
+    _layout->head.store(0, std::memory_order_relaxed);
+    _layout->ringSize = RingSize;
+    _layout->version = Version;
+    __atomic_store_n(&_layout->magic, Magic, __ATOMIC_RELEASE);
+
+    _name = name;
+    _owner = true;
+    return 0;
+#endif
+}
+
+int CCTalkSharedExport::attach(const std::string name){
+#ifdef _WIN32
+    return -1;
+#else
+    close();
+    int n_fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if(n_fd < 0) return -1;
+    void *n_map = mmap(nullptr, sizeof(Layout), PROT_READ, MAP_SHARED, n_fd, 0);
+    ::close(n_fd);
+    if(n_map == MAP_FAILED) return -1;
+
+    _layout = (Layout*)n_map;
+    if(__atomic_load_n(&_layout->magic, __ATOMIC_ACQUIRE) != Magic || _layout->version != Version ||
+       _layout->ringSize != RingSize) {
+        close();
+        return -2;
+    }
+    _name = name;
+    _owner = false;
+    return 0;
+#endif
+}
+
+void CCTalkSharedExport::close(){
+#ifndef _WIN32
+    if(_layout != nullptr) {
+        munmap((void*)_layout, sizeof(Layout));
+        if(_owner) shm_unlink(_name.c_str());
+    }
+#endif
+    _layout = nullptr;
+    _owner = false;
+    _name.clear();
+}
+
+uint64_t CCTalkSharedExport::nowNs(){
+    struct timespec n_ts;
+    clock_gettime(CLOCK_MONOTONIC, &n_ts);
+    return (uint64_t)n_ts.tv_sec * 1000000000ULL + (uint64_t)n_ts.tv_nsec;
+}
+
+int CCTalkSharedExport::setDevice(const uint8_t bus, const uint8_t address, const bool online, const uint8_t lastEventId,
+                                  const uint32_t lostEvents){
+    if(_layout == nullptr || !_owner) return -1;
+
+    uint32_t n_count = _layout->deviceCount.load(std::memory_order_relaxed);
+    uint32_t n_index = 0;
+    while(n_index < n_count) {
+        if(_layout->devices[n_index].bus == bus && _layout->devices[n_index].address == address) break;
+        n_index++;
+    }
+    if(n_index == n_count && n_count == (uint32_t)MaxDevices) return -1;
+
+    DeviceState &n_slot = _layout->devices[n_index];
+    uint32_t n_seq = n_slot.seq.load(std::memory_order_relaxed);
+    n_slot.seq.store(n_seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    n_slot.bus = bus;
+    n_slot.address = address;
+    n_slot.online = online ? 1 : 0;
+    n_slot.lastEventId = lastEventId;
+    n_slot.lostEvents = lostEvents;
+    n_slot.updateNs = nowNs();
+
+    n_slot.seq.store(n_seq + 2, std::memory_order_release);
+    if(n_index == n_count) _layout->deviceCount.store(n_count + 1, std::memory_order_release);
+    return 0;
+}
+
+void CCTalkSharedExport::setBusOffline(const uint8_t bus){
+    if(_layout == nullptr || !_owner) return;
+    uint32_t n_count = _layout->deviceCount.load(std::memory_order_relaxed);
+    for(uint32_t n_index = 0; n_index < n_count; n_index++) {
+        DeviceState &n_slot = _layout->devices[n_index];
+        if(n_slot.bus == bus && n_slot.online) setDevice(bus, n_slot.address, false, n_slot.lastEventId, n_slot.lostEvents);
+    }
+}
+
+void CCTalkSharedExport::publishEvent(const uint8_t bus, const uint8_t address, const uint8_t type, const uint8_t value){
+    if(_layout == nullptr || !_owner) return;
+
+    uint64_t n_head = _layout->head.load(std::memory_order_relaxed);
+    Event &n_slot = _layout->ring[n_head & (RingSize - 1)];
+
+    n_slot.seq.store(2 * n_head + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    n_slot.bus = bus;
+    n_slot.address = address;
+    n_slot.type = type;
+    n_slot.value = value;
+    n_slot.timestampNs = nowNs();
+    n_slot.seq.store(2 * n_head + 2, std::memory_order_release);
+    _layout->head.store(n_head + 1, std::memory_order_release);
+
+    // Per device event count
+    uint32_t n_count = _layout->deviceCount.load(std::memory_order_relaxed);
+    for(uint32_t n_index = 0; n_index < n_count; n_index++) {
+        DeviceState &n_device = _layout->devices[n_index];
+        if(n_device.bus != bus || n_device.address != address) continue;
+        uint32_t n_seq = n_device.seq.load(std::memory_order_relaxed);
+        n_device.seq.store(n_seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        n_device.eventCount++;
+        n_device.seq.store(n_seq + 2, std::memory_order_release);
+        break;
+    }
+}
+
+uint64_t CCTalkSharedExport::getHead() const {
+    if(_layout == nullptr) return 0;
+    return _layout->head.load(std::memory_order_acquire);
+}
+
+int CCTalkSharedExport::getDeviceCount() const {
+    if(_layout == nullptr) return 0;
+    return (int)_layout->deviceCount.load(std::memory_order_acquire);
+}
+
+int CCTalkSharedExport::readDevice(const int index, DeviceSnapshot &device) const {
+    if(index < 0 || index >= getDeviceCount()) return -1;
+    const DeviceState &n_slot = _layout->devices[index];
+
+    while(true) {
+        uint32_t n_before = n_slot.seq.load(std::memory_order_acquire);
+        if(n_before & 1) continue;      // Writer busy
+
+        device.bus = n_slot.bus;
+        device.address = n_slot.address;
+        device.online = (n_slot.online != 0);
+        device.lastEventId = n_slot.lastEventId;
+        device.lostEvents = n_slot.lostEvents;
+        device.eventCount = n_slot.eventCount;
+        device.updateNs = n_slot.updateNs;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(n_slot.seq.load(std::memory_order_relaxed) == n_before) return 0;
+    }
+}
+
+int CCTalkSharedExport::readEvent(const uint64_t n, EventSnapshot &event) const {
+    if(_layout == nullptr) return -1;
+    const Event &n_slot = _layout->ring[n & (RingSize - 1)];
+    const uint64_t n_expected = 2 * n + 2;
+
+    uint64_t n_before = n_slot.seq.load(std::memory_order_acquire);
+    if(n_before < n_expected) return 1;
+    if(n_before != n_expected) return -1;
+
+    event.bus = n_slot.bus;
+    event.address = n_slot.address;
+    event.type = n_slot.type;
+    event.value = n_slot.value;
+    event.timestampNs = n_slot.timestampNs;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return (n_slot.seq.load(std::memory_order_relaxed) == n_expected) ? 0 : -1;
+}
@@ -0,0 +1,191 @@
+/**
+ * @file cctalkshm.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief CCTalk device state and event export through POSIX shared memory
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _CCTALK_SHM_H_
+#define _CCTALK_SHM_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+/**
+ * @brief Shared memory export of device state and events.
+ * One writer (the daemon) creates the region, any number of readers attach read only.
+ * Readers never make a syscall after attaching:
+ *
+ *  - Each device slot is guarded by a seqlock. The counter is odd while the writer
+ *    updates the slot, a reader retries if it changed during the copy.
+ *  - Events go to a ring of RingSize slots. Event n is stored in slot n % RingSize
+ *    and the slot sequence is 2n+2 once complete. A reader that falls more than
+ *    RingSize events behind notices it as a sequence mismatch.
+ */
+class CCTalkSharedExport {
+    public:
+    static const uint32_t Magic = 0x43435453;   // "CCTS"
+    static const uint32_t Version = 2;
+    static const int MaxDevices = 32;
+    static const uint32_t RingSize = 1024;      // Must be a power of two
+
+    /** @brief Device state slot */
+    struct DeviceState {
+        std::atomic<uint32_t> seq;
+        uint8_t bus;
+        uint8_t address;
+        uint8_t online;
+        uint8_t lastEventId;
+        uint32_t lostEvents;        // Events lost to device buffer overflow
+        uint64_t eventCount;        // Events published for this device
+        uint64_t updateNs;          // CLOCK_MONOTONIC time of the last update
+    };
+
+    /** @brief Event ring slot */
+    struct Event {
+        std::atomic<uint64_t> seq;
+        uint8_t bus;
+        uint8_t address;
+        uint8_t type;               // Credit (coin id) or error code, see CCT_Event
+        uint8_t value;              // Sorter path or 0 for errors
+        uint32_t reserved;
+        uint64_t timestampNs;       // CLOCK_MONOTONIC
+    };
+
+    /** @brief Complete shared memory layout */
+    struct Layout {
+        uint32_t magic;
+        uint32_t version;
+        std::atomic<uint32_t> deviceCount;
+        uint32_t ringSize;
+        std::atomic<uint64_t> head;     // Number of published events
+        DeviceState devices[MaxDevices];
+        Event ring[RingSize];
+    };
+
+    /** @brief Plain copy of a device slot */
+    struct DeviceSnapshot {
+        uint8_t bus;
+        uint8_t address;
+        bool online;
+        uint8_t lastEventId;
+        uint32_t lostEvents;
+        uint64_t eventCount;
+        uint64_t updateNs;
+    };
+
+    /** @brief Plain copy of an event */
+    struct EventSnapshot {
+        uint8_t bus;
+        uint8_t address;
+        uint8_t type;
+        uint8_t value;
+        uint64_t timestampNs;
+    };
+
+    public:
+    CCTalkSharedExport();
+    ~CCTalkSharedExport();
+
+    /**
+     * @brief Create (or reset) the region as writer
+     *
+     * @param name Shared memory name, e.g. "/cctalk"
+     * @return Success
+     */
+    int create(const std::string name);
+
+    /**
+     * @brief Attach to an existing region as reader
+     *
+     * @param name Shared memory name
+     * @return Success, -2 if the region has an unknown layout
+     */
+    int attach(const std::string name);
+
+    /**
+     * @brief Unmap the region, the writer also removes the name
+     */
+    void close();
+
+    /**
+     * @brief Update the state of a device, the slot is allocated on first use
+     *
+     * @param bus Bus index
+     * @param address Device address
+     * @param online Device answers
+     * @param lastEventId Last event counter read from the device
+     * @param lostEvents Total events lost to buffer overflow
+     * @return Success, -1 if all slots are taken
+     */
+    int setDevice(const uint8_t bus, const uint8_t address, const bool online, const uint8_t lastEventId,
+                  const uint32_t lostEvents=0);
+
+    /**
+     * @brief Mark all devices of a bus offline
+     *
+     * @param bus Bus index
+     */
+    void setBusOffline(const uint8_t bus);
+
+    /**
+     * @brief Publish an event
+     *
+     * @param bus Bus index
+     * @param address Device address
+     * @param type Event type
+     * @param value Event value
+     */
+    void publishEvent(const uint8_t bus, const uint8_t address, const uint8_t type, const uint8_t value);
+
+    /**
+     * @brief Get the number of published events
+     *
+     * @return Event count, the next event gets this number
+     */
+    uint64_t getHead() const;
+
+    /**
+     * @brief Get the number of device slots in use
+     *
+     * @return Device count
+     */
+    int getDeviceCount() const;
+
+    /**
+     * @brief Read a device slot
+     *
+     * @param index Slot index
+     * @param device Reference to snapshot
+     * @return Success
+     */
+    int readDevice(const int index, DeviceSnapshot &device) const;
+
+    /**
+     * @brief Read event number n
+     *
+     * @param n Event number
+     * @param event Reference to snapshot
+     * @return Success, 1 if not published yet and -1 if overwritten
+     */
+    int readEvent(const uint64_t n, EventSnapshot &event) const;
+
+    private:
+    /**
+     * @brief Monotonic time in nano seconds
+     *
+     * @return Time
+     */
+    static uint64_t nowNs();
+
+    private:
+    Layout *_layout;
+    std::string _name;
+    bool _owner;
+};
+
+#endif //_CCTALK_SHM_H_
@@ -0,0 +1,75 @@
+/**
+ * @file arena.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Per thread bump allocator
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** @brief Block alignment, a cache line */
+static const size_t BlockAlign = 64;
+
+Arena::Arena() : _block(nullptr), _size(0), _used(0){ }
+
+Arena::~Arena(){
+    release();
+}
+
+int Arena::reserve(const size_t size){
+    release();
+    if(size == 0) return -1;
+
+    size_t n_size = (size + BlockAlign - 1) & ~(BlockAlign - 1);
+#ifdef _WIN32
+    _block = (uint8_t*)_aligned_malloc(n_size, BlockAlign);
+#else
+    void *n_mem = nullptr;
+    _block = (posix_memalign(&n_mem, BlockAlign, n_size) == 0) ? (uint8_t*)n_mem : nullptr;
+#endif
+    if(_block == nullptr) return -1;
+
+    // Fault every page in now, not on the first frame
+    memset(_block, 0, n_size);
+    _size = n_size;
+    _used = 0;
+    return 0;
+}
+
+void Arena::release(){
+    if(_block != nullptr) {
+#ifdef _WIN32
+        _aligned_free(_block);
+#else
+        free(_block);
+#endif
+    }
+    _block = nullptr;
+    _size = 0;
+    _used = 0;
+}
+
+void *Arena::allocate(const size_t size, const size_t align){
+    if(_block == nullptr) return nullptr;
+    size_t n_start = (_used + align - 1) & ~(align - 1);
+    if(n_start > _size || size > _size - n_start) return nullptr;
+    _used = n_start + size;
+    return _block + n_start;
+}
+
+void Arena::reset(){
+    _used = 0;
+}
+
+size_t Arena::getUsed() const {
+    return _used;
+}
+
+size_t Arena::getSize() const {
+    return _size;
+}
@@ -0,0 +1,105 @@
+/**
+ * @file arena.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Per thread bump allocator
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+/**
+ * @brief Memory arena owned by one thread.
+ * The block is allocated and touched once by the owning thread, so its pages are
+ * faulted in up front (and on the memory node of the core the thread runs on).
+ * Allocation is a pointer bump without locking; memory is only returned by reset().
+ */
+class Arena {
+    public:
+    Arena();
+    ~Arena();
+
+    /**
+     * @brief Allocate and touch the block, any previous block is freed
+     *
+     * @param size Block size in bytes
+     * @return Success
+     */
+    int reserve(const size_t size);
+
+    /**
+     * @brief Free the block
+     */
+    void release();
+
+    /**
+     * @brief Allocate memory from the block
+     *
+     * @param size Number of bytes
+     * @param align Alignment, must be a power of two
+     * @return Pointer or nullptr if the block is exhausted
+     */
+    void *allocate(const size_t size, const size_t align=alignof(std::max_align_t));
+
+    /**
+     * @brief Construct an object in the arena
+     *
+     * @param args Constructor arguments
+     * @return Pointer or nullptr if the block is exhausted
+     */
+    template<typename T, typename... Args>
+    T *create(Args&&... args){
+        void *n_mem = allocate(sizeof(T), alignof(T));
+        if(n_mem == nullptr) return nullptr;
+        return new (n_mem) T(std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Run the destructor of an object made by create(), the memory is kept until reset()
+     *
+     * @param object Object pointer (may be nullptr)
+     */
+    template<typename T>
+    static void destroy(T *object){
+        if(object != nullptr) object->~T();
+    }
+
+    /**
+     * @brief Make the whole block available again, objects must be destroyed first
+     */
+    void reset();
+
+    /**
+     * @brief Get the number of bytes in use
+     *
+     * @return Bytes
+     */
+    size_t getUsed() const;
+
+    /**
+     * @brief Get the block size
+     *
+     * @return Bytes
+     */
+    size_t getSize() const;
+
+    private:
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    private:
+    uint8_t *_block;
+    size_t _size;
+    size_t _used;
+};
+
+#endif //_ARENA_H_
@@ -0,0 +1,71 @@
+/**
+ * @file realtime.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Real-time scheduling and memory locking for bus I/O threads
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include "realtime.h"
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+int RealTime::lockMemory(){
+#ifdef _WIN32
+    return -1;
+#else
+    return (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) ? 0 : -1;
+#endif
+}
+
+int RealTime::unlockMemory(){
+#ifdef _WIN32
+    return -1;
+#else
+    return (munlockall() == 0) ? 0 : -1;
+#endif
+}
+
+int RealTime::setThreadPriority(const int priority){
+#ifdef _WIN32
+    int n_priority = (priority > 0) ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_NORMAL;
+    return (SetThreadPriority(GetCurrentThread(), n_priority) != 0) ? 0 : -1;
+#else
+    struct sched_param n_param;
+    memset(&n_param, 0, sizeof(n_param));
+    if(priority <= 0) return (pthread_setschedparam(pthread_self(), SCHED_OTHER, &n_param) == 0) ? 0 : -1;
+
+    int n_max = sched_get_priority_max(SCHED_FIFO);
+    n_param.sched_priority = (priority > n_max) ? n_max : priority;
+    return (pthread_setschedparam(pthread_self(), SCHED_FIFO, &n_param) == 0) ? 0 : -1;
+#endif
+}
+
+void __attribute__((noinline)) RealTime::prefaultStack(){
+    volatile uint8_t n_stack[StackPrefault];
+    for(size_t n_pos = 0; n_pos < StackPrefault; n_pos += 1024) n_stack[n_pos] = 0;
+    n_stack[StackPrefault - 1] = n_stack[0];
+}
+
+void RealTime::prefault(void *buffer, const size_t size){
+    if(buffer == nullptr) return;
+    volatile uint8_t *n_bytes = (volatile uint8_t*)buffer;
+    for(size_t n_pos = 0; n_pos < size; n_pos += 1024) n_bytes[n_pos] = n_bytes[n_pos];
+    if(size > 0) n_bytes[size - 1] = n_bytes[size - 1];
+}
+
+int RealTime::enterThread(const int priority){
+    prefaultStack();
+    return setThreadPriority(priority);
+}
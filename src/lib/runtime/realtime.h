@@ -0,0 +1,76 @@
+/**
+ * @file realtime.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Real-time scheduling and memory locking for bus I/O threads
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _REALTIME_H_
+#define _REALTIME_H_
+
+#include <stddef.h>
+
+/**
+ * @brief Opt-in real-time mode.
+ * Under the default scheduler a thread waiting for a reply can be woken late by
+ * milli seconds, and a page fault on a cold buffer costs the same. Real-time mode
+ * removes both: the I/O thread runs SCHED_FIFO, all process memory is locked and
+ * the stack and buffers are touched before the first transfer.
+ *
+ * SCHED_FIFO and mlockall need CAP_SYS_NICE / CAP_IPC_LOCK (or matching rlimits).
+ */
+class RealTime {
+    public:
+    /** @brief Default SCHED_FIFO priority, below the kernel's irq threads (50) */
+    static const int DefaultPriority = 40;
+    /** @brief Stack touched by prefaultStack() */
+    static const size_t StackPrefault = 64 * 1024;
+
+    /**
+     * @brief Lock all current and future pages of the process in RAM
+     *
+     * @return Success
+     */
+    static int lockMemory();
+
+    /**
+     * @brief Undo lockMemory()
+     *
+     * @return Success
+     */
+    static int unlockMemory();
+
+    /**
+     * @brief Set the scheduling of the calling thread
+     *
+     * @param priority SCHED_FIFO priority (1-99), 0 to return to the default scheduler
+     * @return Success
+     */
+    static int setThreadPriority(const int priority);
+
+    /**
+     * @brief Touch StackPrefault bytes of stack so later calls don't fault
+     */
+    static void prefaultStack();
+
+    /**
+     * @brief Touch every page of a buffer
+     *
+     * @param buffer Buffer
+     * @param size Size in bytes
+     */
+    static void prefault(void *buffer, const size_t size);
+
+    /**
+     * @brief Put the calling thread in real-time mode: priority and prefaulted stack
+     *
+     * @param priority SCHED_FIFO priority
+     * @return Success, -1 if the priority couldn't be set
+     */
+    static int enterThread(const int priority=DefaultPriority);
+};
+
+#endif //_REALTIME_H_
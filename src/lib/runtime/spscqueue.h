@@ -0,0 +1,99 @@
+/**
+ * @file spscqueue.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Lock-free single producer, single consumer queue
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _SPSC_QUEUE_H_
+#define _SPSC_QUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * @brief Fixed size ring for handing items from one thread to another.
+ * Exactly one thread may push and exactly one thread may pop. Head and tail live
+ * on separate cache lines, and each side keeps a cached copy of the other index
+ * so the shared line is only read when the ring looks full or empty.
+ *
+ * @tparam T Item type (copy assignable)
+ * @tparam Capacity Number of slots, must be a power of two
+ */
+template<typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+    static const size_t CacheLine = 64;
+
+    SpscQueue() : _head(0), _tailCache(0), _tail(0), _headCache(0){ }
+
+    /**
+     * @brief Add an item, producer side only
+     *
+     * @param item Item to add
+     * @return true if added, false if the queue is full
+     */
+    bool push(const T &item){
+        const size_t n_tail = _tail.load(std::memory_order_relaxed);
+        if(n_tail - _headCache == Capacity) {
+            _headCache = _head.load(std::memory_order_acquire);
+            if(n_tail - _headCache == Capacity) return false;
+        }
+        _slots[n_tail & (Capacity - 1)] = item;
+        _tail.store(n_tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Take the oldest item, consumer side only
+     *
+     * @param item Reference to copy the item into
+     * @return true if an item was taken, false if the queue is empty
+     */
+    bool pop(T &item){
+        const size_t n_head = _head.load(std::memory_order_relaxed);
+        if(n_head == _tailCache) {
+            _tailCache = _tail.load(std::memory_order_acquire);
+            if(n_head == _tailCache) return false;
+        }
+        item = _slots[n_head & (Capacity - 1)];
+        _head.store(n_head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Get the number of queued items, exact only when called by producer or consumer
+     *
+     * @return Number of items
+     */
+    size_t size() const {
+        return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Check if the queue is empty
+     *
+     * @return Result
+     */
+    bool empty() const {
+        return size() == 0;
+    }
+
+    private:
+    // Consumer side
+    alignas(CacheLine) std::atomic<size_t> _head;
+    size_t _tailCache;
+    // Producer side
+    alignas(CacheLine) std::atomic<size_t> _tail;
+    size_t _headCache;
+
+    alignas(CacheLine) T _slots[Capacity];
+};
+
+#endif //_SPSC_QUEUE_H_
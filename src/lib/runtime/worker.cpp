@@ -0,0 +1,119 @@
+/**
+ * @file worker.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Worker thread pinned to a CPU core
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include "worker.h"
+#include "realtime.h"
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+Worker::Worker() : _running(false), _stopping(false), _errors(0), _arenaSize(DefaultArenaSize), _core(-1), _priority(0){ }
+
+Worker::~Worker(){
+    stop();
+}
+
+void Worker::setArenaSize(const size_t size){
+    _arenaSize = size;
+}
+
+void Worker::setRealTime(const int priority){
+    _priority = priority;
+}
+
+int Worker::start(const int core, Task task, Finish finish){
+    if(_thread.joinable() || !task) return -1;
+    _task = task;
+    _finish = finish;
+    _core = core;
+    _stopping = false;
+    _errors = 0;
+    _running = true;
+    _thread = std::thread(&Worker::run, this);
+    return 0;
+}
+
+void Worker::stop(){
+    if(!_thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> n_lock(_mutex);
+        _stopping = true;
+    }
+    _wake.notify_all();
+    _thread.join();
+}
+
+bool Worker::isRunning() const {
+    return _running;
+}
+
+bool Worker::isStopping() const {
+    return _stopping;
+}
+
+Arena &Worker::getArena(){
+    return _arena;
+}
+
+int Worker::getErrors() const {
+    return _errors;
+}
+
+int Worker::getCore() const {
+    return _core;
+}
+
+void Worker::run(){
+    int n_errors = 0;
+    if(_core >= 0 && pinCurrentThread(_core) != 0) {
+        n_errors |= PinFailed;
+        _core = -1;
+    }
+    // Reserved after pinning so the pages are touched from the right core
+    if(_arenaSize > 0 && _arena.reserve(_arenaSize) != 0) n_errors |= ArenaFailed;
+    if(_priority > 0 && RealTime::enterThread(_priority) != 0) n_errors |= RealTimeFailed;
+    _errors = n_errors;
+
+    while(!_stopping) {
+        int n_wait = _task(*this);
+        if(n_wait < 0) break;
+        if(n_wait == 0) continue;
+
+        std::unique_lock<std::mutex> n_lock(_mutex);
+        _wake.wait_for(n_lock, std::chrono::milliseconds(n_wait), [this]{ return _stopping.load(); });
+    }
+
+    if(_finish) _finish(*this);
+    _arena.release();
+    _running = false;
+}
+
+int Worker::pinCurrentThread(const int core){
+    if(core < 0 || core >= getCoreCount()) return -1;
+#ifdef _WIN32
+    if(core >= (int)(sizeof(DWORD_PTR) * 8)) return -1;
+    return (SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << core) != 0) ? 0 : -1;
+#else
+    cpu_set_t n_set;
+    CPU_ZERO(&n_set);
+    CPU_SET(core, &n_set);
+    return (pthread_setaffinity_np(pthread_self(), sizeof(n_set), &n_set) == 0) ? 0 : -1;
+#endif
+}
+
+int Worker::getCoreCount(){
+    unsigned int n_count = std::thread::hardware_concurrency();
+    return (n_count > 0) ? (int)n_count : 1;
+}
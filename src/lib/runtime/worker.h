@@ -0,0 +1,151 @@
+/**
+ * @file worker.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Worker thread pinned to a CPU core
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _WORKER_H_
+#define _WORKER_H_
+
+#include "arena.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief Runs a task repeatedly on its own thread.
+ * The thread pins itself to the requested core and reserves its arena before the
+ * first call, so all memory the task takes from the arena is local to that thread.
+ * The task returns the time until it wants to run again.
+ */
+class Worker {
+    public:
+    /** @brief Task, returns milli seconds until the next call (0 = right away) or -1 to end the worker */
+    typedef std::function<int(Worker &worker)> Task;
+    /** @brief Called once on the worker thread after the last task call, ie. to destroy arena objects */
+    typedef std::function<void(Worker &worker)> Finish;
+
+    /** @brief Default arena size */
+    static const size_t DefaultArenaSize = 256 * 1024;
+
+    /** @brief Setup steps that failed on the thread, see getErrors() */
+    enum Error {
+        PinFailed       = 0x01,     // Not pinned, runs on any core
+        ArenaFailed     = 0x02,     // No arena, getArena() allocations fail
+        RealTimeFailed  = 0x04      // Default scheduling
+    };
+
+    public:
+    Worker();
+    ~Worker();
+
+    /**
+     * @brief Set the arena size, used by the next start()
+     *
+     * @param size Bytes
+     */
+    void setArenaSize(const size_t size);
+
+    /**
+     * @brief Run the thread in real-time mode (see RealTime), used by the next start()
+     *
+     * @param priority SCHED_FIFO priority, 0 for the default scheduler
+     */
+    void setRealTime(const int priority);
+
+    /**
+     * @brief Start the thread
+     *
+     * @param core Core to pin the thread to, -1 to let the OS scheduler decide
+     * @param task Task to run
+     * @param finish Optional cleanup
+     * @return Success, -1 if already running
+     */
+    int start(const int core, Task task, Finish finish=Finish());
+
+    /**
+     * @brief Ask the task to end and wait for the thread
+     */
+    void stop();
+
+    /**
+     * @brief Check if the thread is running
+     *
+     * @return Result
+     */
+    bool isRunning() const;
+
+    /**
+     * @brief Check if stop() was called, for tasks that loop internally
+     *
+     * @return Result
+     */
+    bool isStopping() const;
+
+    /**
+     * @brief Get the arena, only to be used from the worker thread
+     *
+     * @return Arena
+     */
+    Arena &getArena();
+
+    /**
+     * @brief Get the setup steps that failed, set before the first task call
+     *
+     * @return Error flags, 0 if all succeeded
+     */
+    int getErrors() const;
+
+    /**
+     * @brief Get the core the thread is pinned to
+     *
+     * @return Core or -1
+     */
+    int getCore() const;
+
+    /**
+     * @brief Pin the calling thread to a core
+     *
+     * @param core Core number
+     * @return Success
+     */
+    static int pinCurrentThread(const int core);
+
+    /**
+     * @brief Get the number of cores
+     *
+     * @return Number of cores (at least 1)
+     */
+    static int getCoreCount();
+
+    private:
+    Worker(const Worker &) = delete;
+    Worker &operator=(const Worker &) = delete;
+
+    /**
+     * @brief Thread body
+     */
+    void run();
+
+    private:
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::atomic<bool> _running;
+    std::atomic<bool> _stopping;
+    std::atomic<int> _errors;
+    Task _task;
+    Finish _finish;
+    Arena _arena;
+    size_t _arenaSize;
+    int _core;
+    int _priority;
+};
+
+#endif //_WORKER_H_
@@ -0,0 +1,310 @@
+/**
+ * @file firmwareimage.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Firmware image reader for raw binary, Intel HEX, Motorola S-record and ELF files
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include "firmwareimage.h"
+#include <algorithm>
+#include <ctype.h>
+
+/** @brief Chunk size used when copying file data */
+static const uint32_t ReadChunkSize = 4096;
+
+/** @brief Segments are padded to this alignment */
+static const uint32_t WordSize = 4;
+
+/** @brief ELF program header type for loadable segments */
+static const uint32_t ELF_PT_LOAD = 1;
+
+/**
+ * @brief Read a little endian value from a buffer
+ *
+ * @param bffr Pointer to buffer
+ * @param size Number of bytes (max 8)
+ * @return Value
+ */
+static uint64_t readLE(const uint8_t *bffr, int size){
+    uint64_t n_value = 0;
+    for(int n_index = size - 1; n_index >= 0; n_index--) n_value = (n_value << 8) | bffr[n_index];
+    return n_value;
+}
+
+FirmwareImage::FirmwareImage() : _format(Format::Unknown){ }
+
+FirmwareImage::~FirmwareImage(){ }
+
+void FirmwareImage::clear(){
+    _segments.clear();
+    _format = Format::Unknown;
+}
+
+uint32_t FirmwareImage::getSize() const {
+    uint32_t n_size = 0;
+    for(const Segment &n_segment : _segments) n_size += (uint32_t)n_segment.data.size();
+    return n_size;
+}
+
+FirmwareImage::Format FirmwareImage::detect(const std::string filepath){
+    std::ifstream n_file(filepath, std::ios::binary);
+    if(!n_file.is_open()) return Format::Unknown;
+
+    char n_magic[4] = { 0, 0, 0, 0 };
+    n_file.read(n_magic, 4);
+    if(n_file.gcount() < 2) return Format::Binary;
+
+    if(n_file.gcount() == 4 && n_magic[0] == 0x7F && n_magic[1] == 'E' && n_magic[2] == 'L' && n_magic[3] == 'F')
+        return Format::Elf;
+    if(n_magic[0] == ':' && isxdigit((unsigned char)n_magic[1])) return Format::IntelHex;
+    if(n_magic[0] == 'S' && n_magic[1] >= '0' && n_magic[1] <= '9') return Format::SRecord;
+    return Format::Binary;
+}
+
+int FirmwareImage::load(const std::string filepath, const uint32_t binaryAddress){
+    clear();
+    Format n_format = detect(filepath);
+
+    std::ifstream n_file(filepath, std::ios::binary);
+    if(!n_file.is_open()) return -1;
+
+    int n_res = -2;
+    switch (n_format)
+    {
+    case Format::Binary:    n_res = loadBinary(n_file, binaryAddress); break;
+    case Format::IntelHex:  n_res = loadIntelHex(n_file); break;
+    case Format::SRecord:   n_res = loadSRecord(n_file); break;
+    case Format::Elf:       n_res = loadElf(n_file); break;
+    default:
+        break;
+    }
+
+    if(n_res != 0 || finish() != 0) {
+        clear();
+        return -2;
+    }
+    _format = n_format;
+    return 0;
+}
+
+void FirmwareImage::append(const uint32_t address, const uint8_t *data, const uint32_t len){
+    if(len == 0) return;
+    if(!_segments.empty()) {
+        Segment &n_last = _segments.back();
+        if(n_last.address + (uint32_t)n_last.data.size() == address) {
+            n_last.data.insert(n_last.data.end(), data, data + len);
+            return;
+        }
+    }
+    _segments.emplace_back();
+    _segments.back().address = address;
+    _segments.back().data.assign(data, data + len);
+}
+
+int FirmwareImage::finish(){
+    std::sort(_segments.begin(), _segments.end(), [](const Segment &a, const Segment &b){
+        return a.address < b.address;
+    });
+
+    std::vector<Segment> n_merged;
+    for(Segment &n_segment : _segments) {
+        if(!n_merged.empty()) {
+            Segment &n_last = n_merged.back();
+            const uint64_t n_lastEnd = (uint64_t)n_last.address + n_last.data.size();
+            // Two records for the same address, which one is meant can't be told
+            if(n_segment.address < n_lastEnd) return -1;
+
+            // Touching or sharing a word after padding, the gap is filled with 0xFF
+            const uint64_t n_lastWordEnd = (n_lastEnd + WordSize - 1) & ~(uint64_t)(WordSize - 1);
+            if(n_segment.address <= n_lastWordEnd) {
+                n_last.data.resize(n_segment.address - n_last.address, 0xFF);
+                n_last.data.insert(n_last.data.end(), n_segment.data.begin(), n_segment.data.end());
+                continue;
+            }
+        }
+        n_merged.push_back(std::move(n_segment));
+    }
+
+    for(Segment &n_segment : n_merged) {
+        const uint32_t n_lead = n_segment.address % WordSize;
+        if(n_lead > 0) {
+            n_segment.data.insert(n_segment.data.begin(), n_lead, 0xFF);
+            n_segment.address -= n_lead;
+        }
+        const uint32_t n_tail = (WordSize - n_segment.data.size() % WordSize) % WordSize;
+        n_segment.data.resize(n_segment.data.size() + n_tail, 0xFF);
+    }
+    _segments.swap(n_merged);
+    return 0;
+}
+
+int FirmwareImage::hexToBytes(const std::string &text, std::vector<uint8_t> &bytes){
+    bytes.clear();
+    if(text.size() % 2 != 0) return -1;
+    for(size_t n_pos = 0; n_pos < text.size(); n_pos += 2) {
+        int n_value = 0;
+        for(int n_nibble = 0; n_nibble < 2; n_nibble++) {
+            char n_char = text[n_pos + n_nibble];
+            n_value <<= 4;
+            if(n_char >= '0' && n_char <= '9') n_value |= n_char - '0';
+            else if(n_char >= 'A' && n_char <= 'F') n_value |= n_char - 'A' + 10;
+            else if(n_char >= 'a' && n_char <= 'f') n_value |= n_char - 'a' + 10;
+            else return -1;
+        }
+        bytes.push_back((uint8_t)n_value);
+    }
+    return 0;
+}
+
+int FirmwareImage::loadBinary(std::ifstream &file, const uint32_t address){
+    uint8_t n_bffr[ReadChunkSize];
+    uint32_t n_addr = address;
+    while(file) {
+        file.read((char*)n_bffr, sizeof(n_bffr));
+        uint32_t n_read = (uint32_t)file.gcount();
+        append(n_addr, n_bffr, n_read);
+        n_addr += n_read;
+    }
+    return 0;
+}
+
+int FirmwareImage::loadIntelHex(std::ifstream &file){
+    std::string n_line;
+    std::vector<uint8_t> n_record;
+    uint32_t n_base = 0;
+
+    while(std::getline(file, n_line)) {
+        while(!n_line.empty() && (n_line.back() == '\r' || n_line.back() == ' ')) n_line.pop_back();
+        if(n_line.empty()) continue;
+        if(n_line[0] != ':' || hexToBytes(n_line.substr(1), n_record) != 0) return -1;
+
+        // Count, address (2), type, data, checksum
+        if(n_record.size() < 5 || n_record.size() != (size_t)n_record[0] + 5) return -1;
+        uint8_t n_sum = 0;
+        for(uint8_t n_byte : n_record) n_sum = (uint8_t)(n_sum + n_byte);
+        if(n_sum != 0) return -1;
+
+        const uint8_t n_count = n_record[0];
+        const uint32_t n_offset = ((uint32_t)n_record[1] << 8) | n_record[2];
+        const uint8_t *n_data = &n_record[4];
+
+        switch (n_record[3])
+        {
+        case 0x00:  // Data
+            append(n_base + n_offset, n_data, n_count);
+            break;
+        case 0x01:  // End of file
+            return 0;
+        case 0x02:  // Extended segment address
+            if(n_count != 2) return -1;
+            n_base = (((uint32_t)n_data[0] << 8) | n_data[1]) << 4;
+            break;
+        case 0x04:  // Extended linear address
+            if(n_count != 2) return -1;
+            n_base = (((uint32_t)n_data[0] << 8) | n_data[1]) << 16;
+            break;
+        case 0x03:  // Start segment address
+        case 0x05:  // Start linear address
+            break;
+        default:
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int FirmwareImage::loadSRecord(std::ifstream &file){
+    std::string n_line;
+    std::vector<uint8_t> n_record;
+
+    while(std::getline(file, n_line)) {
+        while(!n_line.empty() && (n_line.back() == '\r' || n_line.back() == ' ')) n_line.pop_back();
+        if(n_line.empty()) continue;
+        if(n_line.size() < 4 || n_line[0] != 'S' || hexToBytes(n_line.substr(2), n_record) != 0) return -1;
+
+        // Count (address + data + checksum), address, data, checksum
+        if(n_record.size() < 2 || n_record.size() != (size_t)n_record[0] + 1) return -1;
+        uint8_t n_sum = 0;
+        for(uint8_t n_byte : n_record) n_sum = (uint8_t)(n_sum + n_byte);
+        if(n_sum != 0xFF) return -1;
+
+        int n_addrLen = 0;
+        switch (n_line[1])
+        {
+        case '1': n_addrLen = 2; break;
+        case '2': n_addrLen = 3; break;
+        case '3': n_addrLen = 4; break;
+        case '7':
+        case '8':
+        case '9':
+            return 0;   // Termination
+        case '0':
+        case '5':
+        case '6':
+            continue;   // Header and record counts
+        default:
+            return -1;
+        }
+
+        const int n_dataLen = (int)n_record[0] - n_addrLen - 1;
+        if(n_dataLen < 0) return -1;
+        uint32_t n_addr = 0;
+        for(int n_index = 0; n_index < n_addrLen; n_index++) n_addr = (n_addr << 8) | n_record[1 + n_index];
+        append(n_addr, &n_record[1 + n_addrLen], (uint32_t)n_dataLen);
+    }
+    return 0;
+}
+
+int FirmwareImage::loadElf(std::ifstream &file){
+    uint8_t n_ident[64];
+    file.read((char*)n_ident, sizeof(n_ident));
+    if(file.gcount() < 52) return -1;
+
+    const bool n_is64 = (n_ident[4] == 2);
+    if(n_ident[4] != 1 && !n_is64) return -1;
+    if(n_ident[5] != 1) return -1;     // Only little endian targets
+
+    const uint64_t n_phoff = n_is64 ? readLE(&n_ident[0x20], 8) : readLE(&n_ident[0x1C], 4);
+    const uint16_t n_phentsize = (uint16_t)readLE(&n_ident[n_is64 ? 0x36 : 0x2A], 2);
+    const uint16_t n_phnum = (uint16_t)readLE(&n_ident[n_is64 ? 0x38 : 0x2C], 2);
+    if(n_phentsize < (n_is64 ? 56 : 32) || n_phentsize > 64) return -1;
+
+    uint8_t n_bffr[ReadChunkSize];
+    for(uint16_t n_index = 0; n_index < n_phnum; n_index++) {
+        uint8_t n_ph[64];
+        file.clear();
+        file.seekg((std::streamoff)(n_phoff + (uint64_t)n_index * n_phentsize));
+        file.read((char*)n_ph, n_phentsize);
+        if(file.gcount() != n_phentsize) return -1;
+
+        uint32_t n_type = (uint32_t)readLE(&n_ph[0], 4);
+        uint64_t n_offset, n_paddr, n_filesz;
+        if(n_is64) {
+            n_offset = readLE(&n_ph[8], 8);
+            n_paddr = readLE(&n_ph[24], 8);
+            n_filesz = readLE(&n_ph[32], 8);
+        } else {
+            n_offset = readLE(&n_ph[4], 4);
+            n_paddr = readLE(&n_ph[12], 4);
+            n_filesz = readLE(&n_ph[16], 4);
+        }
+        if(n_type != ELF_PT_LOAD || n_filesz == 0) continue;
+
+        // Flash the load address (LMA), .data is copied to RAM by the startup code
+        file.seekg((std::streamoff)n_offset);
+        uint64_t n_left = n_filesz;
+        uint32_t n_addr = (uint32_t)n_paddr;
+        while(n_left > 0) {
+            uint32_t n_chunk = (n_left > sizeof(n_bffr)) ? (uint32_t)sizeof(n_bffr) : (uint32_t)n_left;
+            file.read((char*)n_bffr, n_chunk);
+            if((uint32_t)file.gcount() != n_chunk) return -1;
+            append(n_addr, n_bffr, n_chunk);
+            n_addr += n_chunk;
+            n_left -= n_chunk;
+        }
+    }
+    return 0;
+}
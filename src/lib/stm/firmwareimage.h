@@ -0,0 +1,154 @@
+/**
+ * @file firmwareimage.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Firmware image reader for raw binary, Intel HEX, Motorola S-record and ELF files
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _FIRMWAREIMAGE_H_
+#define _FIRMWAREIMAGE_H_
+
+#include <inttypes.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Sparse firmware image.
+ * Files are parsed record by record and contiguous data is merged into segments,
+ * so gaps in the address space take no memory and are never written.
+ * Segments are padded with 0xFF to whole 32 bit words, as the bootloader WRITE
+ * command takes word aligned addresses and lengths only.
+ */
+class FirmwareImage {
+    public:
+    /** @brief Image file formats */
+    enum class Format {
+        Binary      = 0,
+        IntelHex    = 1,
+        SRecord     = 2,
+        Elf         = 3,
+        Unknown     = 4
+    };
+
+    /** @brief Contiguous block of data */
+    struct Segment {
+        uint32_t address;
+        std::vector<uint8_t> data;
+    };
+
+    public:
+    FirmwareImage();
+    ~FirmwareImage();
+
+    /**
+     * @brief Load an image file
+     *
+     * @param filepath Path to file
+     * @param binaryAddress Load address used for raw binary files
+     * @return Success, -1 if the file can't be opened and -2 on parse errors or overlapping records
+     */
+    int load(const std::string filepath, const uint32_t binaryAddress=0x08000000);
+
+    /**
+     * @brief Detect the file format from the file content
+     *
+     * @param filepath Path to file
+     * @return File format
+     */
+    static Format detect(const std::string filepath);
+
+    /**
+     * @brief Get the segments sorted by address
+     *
+     * @return Segment list
+     */
+    const std::vector<Segment> &getSegments() const { return _segments; }
+
+    /**
+     * @brief Get the number of data bytes in all segments
+     *
+     * @return Number of bytes
+     */
+    uint32_t getSize() const;
+
+    /**
+     * @brief Get the format of the loaded file
+     *
+     * @return File format
+     */
+    Format getFormat() const { return _format; }
+
+    /**
+     * @brief Remove all segments
+     */
+    void clear();
+
+    private:
+    /**
+     * @brief Load a raw binary file as one segment
+     *
+     * @param file Open file
+     * @param address Load address
+     * @return Success
+     */
+    int loadBinary(std::ifstream &file, const uint32_t address);
+
+    /**
+     * @brief Parse an Intel HEX file line by line
+     *
+     * @param file Open file
+     * @return Success
+     */
+    int loadIntelHex(std::ifstream &file);
+
+    /**
+     * @brief Parse a Motorola S-record file line by line
+     *
+     * @param file Open file
+     * @return Success
+     */
+    int loadSRecord(std::ifstream &file);
+
+    /**
+     * @brief Load the PT_LOAD segments of an ELF file at their physical address
+     *
+     * @param file Open file
+     * @return Success
+     */
+    int loadElf(std::ifstream &file);
+
+    /**
+     * @brief Add data, merging it with the previous segment when contiguous
+     *
+     * @param address Start address
+     * @param data Pointer to data
+     * @param len Number of bytes
+     */
+    void append(const uint32_t address, const uint8_t *data, const uint32_t len);
+
+    /**
+     * @brief Sort segments, merge the ones that touch or share a word and pad them to whole words
+     *
+     * @return Success, -1 if records overlap
+     */
+    int finish();
+
+    /**
+     * @brief Convert hex characters to bytes
+     *
+     * @param text Hex text
+     * @param bytes Reference to the output bytes
+     * @return Success
+     */
+    static int hexToBytes(const std::string &text, std::vector<uint8_t> &bytes);
+
+    private:
+    std::vector<Segment> _segments;
+    Format _format;
+};
+
+#endif //_FIRMWAREIMAGE_H_
@@ -0,0 +1,68 @@
+/**
+ * @file flashloader.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Protocol of the RAM resident flash loader
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * The ROM bootloader writes at most 256 bytes per command and waits for an ACK
+ * after each, at the baud rate picked at sync. The flash loader is a small
+ * program the host uploads to SRAM with WRITE and starts with GO. It then takes
+ * large blocks at a higher baud rate and programs flash on its own.
+ *
+ * The loader image starts with a vector table (initial SP, reset handler), as GO
+ * loads both from the start address. It is built for the target separately.
+ *
+ * Frames, all values little endian:
+ *   request  Sof, command,   length (2), payload, CRC32 (4)
+ *   reply    Sof, status,    length (2), payload, CRC32 (4)
+ * The CRC32 (IEEE 802.3) covers command/status, length and payload. A request
+ * with a bad CRC is answered with Status::CRC_ERROR and not executed.
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _FLASHLOADER_H_
+#define _FLASHLOADER_H_
+
+#include <stdint.h>
+
+class FlashLoader {
+    public:
+    /** @brief Start of frame */
+    static const uint8_t Sof = 0xA5;
+    /** @brief Frame bytes besides the payload */
+    static const int FrameOverhead = 8;
+    /** @brief Largest payload the host sends, the loader may report a smaller block size */
+    static const uint32_t MaxPayload = 16 * 1024 + 16;
+    /** @brief Load address chosen from the chip database, right above the RAM used by the ROM bootloader */
+    static const uint32_t AutoAddress = 0;
+
+    /** @brief Loader commands */
+    enum class Command : uint8_t {
+        PING        = 0x01,   /*!< Reply: version (1), max write block (4), features (1, optional) */
+        SET_BAUD    = 0x02,   /*!< Bitrate (4), replied at the old rate, then switched */
+        ERASE       = 0x03,   /*!< Address (4), length (4): erase the pages covering the range */
+        WRITE       = 0x04,   /*!< Address (4), data: program flash. Data equal to the flash content
+                                   succeeds, so a block whose reply got lost can be sent again */
+        CRC         = 0x05,   /*!< Address (4), length (4). Reply: CRC32 (4) of the flash range */
+        RESET       = 0x06,   /*!< Reply, then system reset into the application */
+        WRITE_LZ4   = 0x07,   /*!< Address (4), length (4), CRC32 of the data (4), LZ4 block (see lz4block.h).
+                                   The loader decompresses, checks the CRC and programs like WRITE */
+    };
+
+    /** @brief Feature bits of the PING reply */
+    static const uint8_t FeatureLz4 = 0x01;
+
+    /** @brief Reply status */
+    enum class Status : uint8_t {
+        OK              = 0x00,
+        CRC_ERROR       = 0x01,   /*!< Request CRC mismatch */
+        BAD_REQUEST     = 0x02,   /*!< Unknown command or bad length */
+        BAD_ADDRESS     = 0x03,   /*!< Range outside flash */
+        FLASH_ERROR     = 0x04,   /*!< Erase or program failed */
+        DATA_ERROR      = 0x05,   /*!< Decompressed block has the wrong length or CRC */
+    };
+};
+
+#endif //_FLASHLOADER_H_
@@ -0,0 +1,159 @@
+/**
+ * @file lz4block.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief LZ4 block format compressor for firmware transfer
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include "lz4block.h"
+#include <string.h>
+
+/** @brief Shortest match */
+static const uint32_t MinMatch = 4;
+/** @brief The last match must start this many bytes before the end */
+static const uint32_t MatchStartLimit = 12;
+/** @brief The last bytes are always literals */
+static const uint32_t LastLiterals = 5;
+/** @brief Hash table size (log2) */
+static const int HashLog = 12;
+
+static inline uint32_t read32(const uint8_t *src){
+    uint32_t n_value;
+    memcpy(&n_value, src, 4);
+    return n_value;
+}
+
+static inline uint32_t hash(const uint32_t sequence){
+    return (sequence * 2654435761u) >> (32 - HashLog);
+}
+
+/**
+ * @brief Append a length continuation (255 runs and the remainder)
+ *
+ * @param dst Output
+ * @param len Length beyond the 15 held by the token
+ */
+static void putLength(std::vector<uint8_t> &dst, uint32_t len){
+    while(len >= 255) {
+        dst.push_back(255);
+        len -= 255;
+    }
+    dst.push_back((uint8_t)len);
+}
+
+/**
+ * @brief Append a sequence: literals followed by a match (matchLen 0 for the last literals)
+ *
+ * @param dst Output
+ * @param literals Literal bytes
+ * @param literalLen Number of literals
+ * @param offset Match offset
+ * @param matchLen Match length
+ */
+static void putSequence(std::vector<uint8_t> &dst, const uint8_t *literals, const uint32_t literalLen,
+                        const uint32_t offset, const uint32_t matchLen){
+    uint8_t n_token = (uint8_t)(((literalLen >= 15) ? 15 : literalLen) << 4);
+    uint32_t n_matchCode = (matchLen >= MinMatch) ? matchLen - MinMatch : 0;
+    if(matchLen >= MinMatch) n_token |= (uint8_t)((n_matchCode >= 15) ? 15 : n_matchCode);
+
+    dst.push_back(n_token);
+    if(literalLen >= 15) putLength(dst, literalLen - 15);
+    dst.insert(dst.end(), literals, literals + literalLen);
+    if(matchLen < MinMatch) return;
+
+    dst.push_back((uint8_t)(offset & 0xff));
+    dst.push_back((uint8_t)(offset >> 8));
+    if(n_matchCode >= 15) putLength(dst, n_matchCode - 15);
+}
+
+/**
+ * @brief Read a length continuation
+ *
+ * @param src Compressed data
+ * @param len Number of compressed bytes
+ * @param pos Reference to the read position, advanced
+ * @param value Reference to the length, the continuation is added
+ * @return Success, -1 if the data ends within the continuation
+ */
+static int getLength(const uint8_t *src, const uint32_t len, uint32_t &pos, uint32_t &value){
+    uint8_t n_byte = 255;
+    while(n_byte == 255) {
+        if(pos >= len) return -1;
+        n_byte = src[pos++];
+        value += n_byte;
+    }
+    return 0;
+}
+
+int LZ4Block::decompress(const uint8_t *src, const uint32_t len, uint8_t *dst, const uint32_t capacity){
+    uint32_t n_pos = 0;
+    uint32_t n_out = 0;
+
+    while(n_pos < len) {
+        const uint8_t n_token = src[n_pos++];
+        uint32_t n_literals = n_token >> 4;
+        if(n_literals == 15 && getLength(src, len, n_pos, n_literals) != 0) return -1;
+        if(n_literals > len - n_pos || n_literals > capacity - n_out) return -1;
+        memcpy(&dst[n_out], &src[n_pos], n_literals);
+        n_pos += n_literals;
+        n_out += n_literals;
+
+        // The last sequence only has literals
+        if(n_pos == len) return (int)n_out;
+
+        if(len - n_pos < 2) return -1;
+        const uint32_t n_offset = (uint32_t)src[n_pos] | ((uint32_t)src[n_pos + 1] << 8);
+        n_pos += 2;
+        if(n_offset == 0 || n_offset > n_out) return -1;
+
+        uint32_t n_match = n_token & 0x0F;
+        if(n_match == 15 && getLength(src, len, n_pos, n_match) != 0) return -1;
+        n_match += MinMatch;
+        if(n_match > capacity - n_out) return -1;
+
+        // Byte by byte, the match may overlap the bytes it produces
+        for(uint32_t n_index = 0; n_index < n_match; n_index++, n_out++) dst[n_out] = dst[n_out - n_offset];
+    }
+    return -1;  // Empty input or missing last literals
+}
+
+uint32_t LZ4Block::bound(const uint32_t len){
+    return len + len / 255 + 16;
+}
+
+uint32_t LZ4Block::compress(const uint8_t *src, const uint32_t len, std::vector<uint8_t> &dst){
+    dst.clear();
+    dst.reserve(bound(len));
+
+    uint32_t n_anchor = 0;
+    if(len > MatchStartLimit) {
+        std::vector<int32_t> n_table((size_t)1 << HashLog, -1);
+        const uint32_t n_startLimit = len - MatchStartLimit;
+        const uint32_t n_matchLimit = len - LastLiterals;
+        uint32_t n_pos = 0;
+
+        while(n_pos < n_startLimit) {
+            const uint32_t n_sequence = read32(&src[n_pos]);
+            const uint32_t n_hash = hash(n_sequence);
+            const int32_t n_ref = n_table[n_hash];
+            n_table[n_hash] = (int32_t)n_pos;
+
+            if(n_ref < 0 || n_pos - (uint32_t)n_ref > MaxOffset || read32(&src[n_ref]) != n_sequence) {
+                n_pos++;
+                continue;
+            }
+
+            uint32_t n_matchLen = MinMatch;
+            while(n_pos + n_matchLen < n_matchLimit && src[n_ref + n_matchLen] == src[n_pos + n_matchLen]) n_matchLen++;
+
+            putSequence(dst, &src[n_anchor], n_pos - n_anchor, n_pos - (uint32_t)n_ref, n_matchLen);
+            n_pos += n_matchLen;
+            n_anchor = n_pos;
+        }
+    }
+    putSequence(dst, &src[n_anchor], len - n_anchor, 0, 0);
+    return (uint32_t)dst.size();
+}
@@ -0,0 +1,61 @@
+/**
+ * @file lz4block.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief LZ4 block format compressor for firmware transfer
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _LZ4BLOCK_H_
+#define _LZ4BLOCK_H_
+
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @brief Compresses to the LZ4 block format (no frame header, no checksums).
+ * The decoder is a few hundred bytes of code and needs no memory besides the
+ * output buffer, which makes it suitable for a RAM resident flash loader.
+ * The compressor is greedy with a 4K entry hash table; firmware mostly
+ * compresses on erased-flash padding and repeated tables, which it catches.
+ */
+class LZ4Block {
+    public:
+    /** @brief Largest match offset of the format */
+    static const uint32_t MaxOffset = 65535;
+
+    /**
+     * @brief Compress a block
+     *
+     * @param src Source data
+     * @param len Number of bytes
+     * @param dst Reference to output, replaced
+     * @return Compressed size
+     */
+    static uint32_t compress(const uint8_t *src, const uint32_t len, std::vector<uint8_t> &dst);
+
+    /**
+     * @brief Decompress a block, checking every length and offset against the buffers.
+     * Same format rules as the reference LZ4_decompress_safe(). The host decodes each
+     * block it compresses before sending it, as a check on the compressor.
+     *
+     * @param src Compressed data
+     * @param len Number of compressed bytes
+     * @param dst Output buffer
+     * @param capacity Size of the output buffer
+     * @return Decompressed size, -1 if the block is malformed or doesn't fit
+     */
+    static int decompress(const uint8_t *src, const uint32_t len, uint8_t *dst, const uint32_t capacity);
+
+    /**
+     * @brief Get the worst case compressed size
+     *
+     * @param len Source size
+     * @return Bytes
+     */
+    static uint32_t bound(const uint32_t len);
+};
+
+#endif //_LZ4BLOCK_H_
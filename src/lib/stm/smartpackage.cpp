@@ -0,0 +1,108 @@
+/**
+ * @file smartpackage.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Smart package (0xFEFEFEFE) container reader
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include "smartpackage.h"
+
+SmartPackage::SmartPackage() : _data(nullptr), _size(0), _mapped(false){
+    memset(&_header, 0, sizeof(_header));
+}
+
+SmartPackage::~SmartPackage(){
+    close();
+}
+
+int SmartPackage::open(const std::string filepath){
+    close();
+
+    int n_file = ::open(filepath.c_str(), O_RDONLY);
+    if(n_file < 0) return -1;
+
+    _size = lseek(n_file, 0, SEEK_END);
+    if(_size <= 0) {
+        ::close(n_file);
+        return -1;
+    }
+
+#ifndef _WIN32
+    void *n_map = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, n_file, 0);
+    if(n_map != MAP_FAILED) {
+        _data = (const uint8_t*)n_map;
+        _mapped = true;
+    }
+#endif
+    if(_data == nullptr) {
+        // No mmap, fall back to reading the file
+        uint8_t *n_bffr = new uint8_t[_size];
+        lseek(n_file, 0, SEEK_SET);
+        if(read(n_file, n_bffr, _size) != _size) {
+            delete [] n_bffr;
+            ::close(n_file);
+            return -1;
+        }
+        _data = n_bffr;
+    }
+    ::close(n_file);
+
+    const long n_HeaderLength = sizeof(STMBoot::Header);
+    if(_size < n_HeaderLength + 4) {
+        close();
+        return -2;
+    }
+    memcpy(&_header, _data + _size - n_HeaderLength, n_HeaderLength);
+
+    uint32_t n_count = 0;
+    memcpy(&n_count, _data + _size - n_HeaderLength - 4, 4);
+    const long n_tocStart = _size - n_HeaderLength - 4 - (long)(n_count * sizeof(Entry));
+
+    if(_header.signature != STMBoot::Signature::SmartPackage || n_tocStart < 0) {
+        close();
+        return -2;
+    }
+
+    for(uint32_t n_index = 0; n_index < n_count; n_index++) {
+        Entry n_entry;
+        memcpy(&n_entry, _data + n_tocStart + n_index * sizeof(Entry), sizeof(Entry));
+        if((long)n_entry.offset + (long)n_entry.size > n_tocStart) {
+            close();
+            return -2;
+        }
+        _entries.push_back(n_entry);
+    }
+    return 0;
+}
+
+void SmartPackage::close(){
+    if(_data != nullptr) {
+#ifndef _WIN32
+        if(_mapped) munmap((void*)_data, _size);
+        else delete [] _data;
+#else
+        delete [] _data;
+#endif
+    }
+    _data = nullptr;
+    _size = 0;
+    _mapped = false;
+    _entries.clear();
+}
+
+const SmartPackage::Entry *SmartPackage::find(const STMBoot::Signature signature) const {
+    for(const Entry &n_entry : _entries) {
+        if(n_entry.signature == signature) return &n_entry;
+    }
+    return nullptr;
+}
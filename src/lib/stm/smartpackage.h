@@ -0,0 +1,105 @@
+/**
+ * @file smartpackage.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Smart package (0xFEFEFEFE) container reader
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _SMARTPACKAGE_H_
+#define _SMARTPACKAGE_H_
+
+#include "stmboot.h"
+#include <string>
+#include <vector>
+
+/**
+ * @brief Smart package reader.
+ * A package holds several images followed by a table of contents, the entry count
+ * and the usual 16 byte STMBoot::Header carrying the SmartPackage signature:
+ *
+ *   [image data ...][Entry x count][uint32 count][STMBoot::Header]
+ *
+ * The file is memory mapped, image data is handed out as pointers into the mapping.
+ */
+class SmartPackage {
+    public:
+    /** @brief Table of contents entry (binary packed) */
+    struct Entry
+    {
+        public:
+        STMBoot::Signature signature;
+        uint32_t offset;        // Offset of the image data in the package
+        uint32_t size;          // Number of bytes
+        uint32_t address;       // Flash address
+        uint16_t build;
+        uint8_t minor;
+        uint8_t major;
+
+    } __attribute__((packed));
+
+    public:
+    SmartPackage();
+    ~SmartPackage();
+
+    /**
+     * @brief Open and index a package file
+     *
+     * @param filepath Path to file
+     * @return Success, -1 if the file can't be opened and -2 if it isn't a valid package
+     */
+    int open(const std::string filepath);
+
+    /**
+     * @brief Release the file mapping
+     */
+    void close();
+
+    /**
+     * @brief Check if a package is open
+     *
+     * @return Result
+     */
+    bool isOpen() const { return _data != nullptr; }
+
+    /**
+     * @brief Get the package header
+     *
+     * @return Header
+     */
+    const STMBoot::Header &getHeader() const { return _header; }
+
+    /**
+     * @brief Get the table of contents
+     *
+     * @return Entry list
+     */
+    const std::vector<Entry> &getEntries() const { return _entries; }
+
+    /**
+     * @brief Find the entry of an image type
+     *
+     * @param signature Image signature
+     * @return Pointer to entry or nullptr
+     */
+    const Entry *find(const STMBoot::Signature signature) const;
+
+    /**
+     * @brief Get the image data of an entry
+     *
+     * @param entry Table of contents entry
+     * @return Pointer to the data inside the mapping
+     */
+    const uint8_t *getData(const Entry &entry) const { return _data + entry.offset; }
+
+    private:
+    STMBoot::Header _header;
+    std::vector<Entry> _entries;
+    const uint8_t *_data;
+    long _size;
+    bool _mapped;
+};
+
+#endif //_SMARTPACKAGE_H_
@@ -11,11 +11,39 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <time.h>
+#include <string.h>
+#include <cstdio>
+#include <chrono>
+#include <iterator>
+#include <algorithm>
 
 #include "stmboot.h"
+#include "smartpackage.h"
+#include "lz4block.h"
+#include "../runtime/realtime.h"
+
+/** @brief Start of the STM32 main flash */
+static const uint32_t FlashBase = 0x08000000;
+/** @brief ACK timeout of the command, address and length steps (s) */
+static const double ShortAckSec = 0.1;
+/** @brief Max pages in one extended erase page list */
+static const uint16_t MaxErasePages = 64;
 
 STMBoot::STMBoot(){
     _filecontent = nullptr;
+    _content_size = 0;
+    _baseAddress = FlashBase;
+    _pageSize = 2048;
+    _pageSizeSet = false;
+    _identified = false;
+    _chip = nullptr;
+    _pid = 0;
+    _bootVersion = 0;
+    _loaderAddress = FlashLoader::AutoAddress;
+    _loaderBitrate = 0;
+    _loaderBlock = 0;
+    _loaderFeatures = 0;
+    _priority = 0;
 }
 
 STMBoot::~STMBoot(){
@@ -24,9 +52,17 @@ STMBoot::~STMBoot(){
 }
 
 int STMBoot::init(Target target){
-    if(_bin_file_path.empty()) return -1;
-    int n_res = loadFileContent();
-    if(n_res != 0) return -1;
+    int n_res = 0;
+    _deviceKey.clear();
+    _identified = false;
+    _chip = nullptr;
+    _bootVersion = 0;
+    _commandList.clear();
+    if(_image.getSegments().empty() && !_package) {
+        if(_bin_file_path.empty()) return -1;
+        n_res = loadFileContent();
+        if(n_res != 0) return -1;
+    }
     set_rts(false);
     set_dtr(false);
     
@@ -63,6 +99,9 @@ int STMBoot::init(Target target){
 }
 
 int STMBoot::setBinaryFile(const std::string filepath){
+    _image.clear();
+    _compressedBlocks.clear();
+    _package.reset();
     _bin_file_path = filepath;
     _content_size = 0;
     if(_filecontent != nullptr) delete [] _filecontent;
@@ -72,14 +111,202 @@ int STMBoot::setBinaryFile(const std::string filepath){
         _bin_file_path = "";
         return -1;
     }
+
+    if(_header.signature == Signature::SmartPackage) {
+        _package.reset(new SmartPackage());
+        if(_package->open(filepath) != 0) {
+            _package.reset();
+            _bin_file_path = "";
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int STMBoot::setImageFile(const std::string filepath){
+    _package.reset();
+    _compressedBlocks.clear();
+    _bin_file_path = "";
+    _content_size = 0;
+    if(_filecontent != nullptr) delete [] _filecontent;
+    _filecontent = nullptr;
+
+    if(_image.load(filepath, _baseAddress) != 0) return -1;
+    if(_image.getSegments().empty()) return -1;
+    return 0;
+}
+
+void STMBoot::setBaseAddress(uint32_t address){
+    _baseAddress = address;
+}
+
+void STMBoot::setPackageFilter(std::function<bool(Signature, uint8_t, uint8_t, uint16_t)> filter){
+    _packageFilter = filter;
+}
+
+void STMBoot::setPageSize(uint32_t pageSize){
+    if(pageSize == 0) return;
+    _pageSize = pageSize;
+    _pageSizeSet = true;
+}
+
+void STMBoot::setFlashLoader(const std::string filepath, uint32_t address, int bitrate){
+    _loaderPath = filepath;
+    _loaderAddress = address;
+    _loaderBitrate = bitrate;
+}
+
+int STMBoot::identify(){
+    if(_identified) return 0;
+    if(get() != 0) return -1;
+    if(getId(_pid) != 0) return -1;
+
+    _chip = STMChip::find(_pid);
+    if(_chip != nullptr && _chip->pageSize > 0 && !_pageSizeSet) _pageSize = _chip->pageSize;
+    _identified = true;
     return 0;
 }
 
+const STMChip *STMBoot::getChip() const {
+    return _chip;
+}
+
+uint8_t STMBoot::getBootloaderVersion() const {
+    return _bootVersion;
+}
+
+int STMBoot::programPackage(bool verbose){
+    const std::vector<SmartPackage::Entry> &n_entries = _package->getEntries();
+    std::vector<bool> n_write(n_entries.size());
+    for(size_t n_index = 0; n_index < n_entries.size(); n_index++) {
+        const SmartPackage::Entry &n_entry = n_entries[n_index];
+        n_write[n_index] = !_packageFilter || _packageFilter(n_entry.signature, n_entry.major, n_entry.minor, n_entry.build);
+    }
+
+    // An image sharing a page with one being written is erased along with it,
+    // so it is written again. Repeat until no shared page is left.
+    bool n_added = true;
+    while(n_added) {
+        n_added = false;
+        for(size_t n_index = 0; n_index < n_entries.size(); n_index++) {
+            if(!n_write[n_index] || n_entries[n_index].size == 0) continue;
+            const SmartPackage::Entry &n_entry = n_entries[n_index];
+            for(size_t n_other = 0; n_other < n_entries.size(); n_other++) {
+                const SmartPackage::Entry &n_next = n_entries[n_other];
+                if(n_write[n_other] || n_next.size == 0) continue;
+                if(pageIndex(n_next.address) <= pageIndex(n_entry.address + n_entry.size - 1) &&
+                   pageIndex(n_entry.address) <= pageIndex(n_next.address + n_next.size - 1)) {
+                    if(verbose) std::printf("Rewriting %08X, it shares a page\n", (uint32_t)n_next.signature);
+                    n_write[n_other] = true;
+                    n_added = true;
+                }
+            }
+        }
+    }
+
+    std::vector<const SmartPackage::Entry*> n_selected;
+    std::vector<Region> n_regions;
+    for(size_t n_index = 0; n_index < n_entries.size(); n_index++) {
+        if(!n_write[n_index]) continue;
+        n_selected.push_back(&n_entries[n_index]);
+        n_regions.push_back({ n_entries[n_index].address, nullptr, n_entries[n_index].size });
+    }
+
+    int n_res = 0;
+    if(n_selected.empty()) {
+        if(verbose) std::printf("All images up to date\n");
+    } else if(n_selected.size() == n_entries.size()) {
+        // Everything is rewritten, one mass erase is the fastest
+        n_res = massErase();
+    } else {
+        std::vector<Region> n_ranges;
+        eraseRanges(n_regions, n_ranges);
+        for(const Region &n_range : n_ranges) {
+            n_res = eraseRange(n_range.address, n_range.size);
+            if(n_res != 0) break;
+        }
+    }
+    if(n_res != 0) {
+        if(verbose) std::printf((n_res == -2) ? "Erase timeout\n" : "Error while erasing %d\n", n_res);
+        return -1;
+    }
+
+    for(const SmartPackage::Entry *n_entry : n_selected) {
+        if(verbose) std::printf("Writing %08X v%d.%d.%d (%u bytes) at %08X\n", (uint32_t)n_entry->signature,
+                                n_entry->major, n_entry->minor, n_entry->build, n_entry->size, n_entry->address);
+        if(writeMemory(n_entry->address, const_cast<uint8_t*>(_package->getData(*n_entry)), 0, n_entry->size) != 0) {
+            if(verbose) std::printf("Error while programming device\n");
+            return -1;
+        }
+        if(verbose && _progressCallback) std::printf("\n");
+    }
+    if(verbose) std::printf("Rebooting device\n");
+    return reboot();
+}
+
+void STMBoot::setRealTime(const int priority){
+    _priority = priority;
+}
+
 int STMBoot::programTarget(bool verbose){
+    if(_priority <= 0) return programSession(verbose);
+
+    // Fault in what the transfer touches, the data itself and the stack
+    if(RealTime::enterThread(_priority) != 0) {
+        if(verbose) std::printf("Unable to set real-time priority %d, running with default scheduling\n", _priority);
+    }
+    if(_filecontent != nullptr) RealTime::prefault(_filecontent, _content_size);
+    for(const FirmwareImage::Segment &n_segment : _image.getSegments())
+        RealTime::prefault(const_cast<uint8_t*>(n_segment.data.data()), n_segment.data.size());
+
+    int n_res = programSession(verbose);
+    RealTime::setThreadPriority(0);
+    return n_res;
+}
+
+int STMBoot::programSession(bool verbose){
     int n_res = 0;
 
-    n_res = extendedErase();
-    const uint32_t address = 0x08000000;
+    if(identify() != 0) {
+        if(verbose) std::printf("Unable to identify target\n");
+        return -1;
+    }
+    if(verbose) std::printf("Target %03X %s, bootloader v%d.%d\n", _pid, (_chip != nullptr) ? _chip->name : "(unknown)",
+                            _bootVersion >> 4, _bootVersion & 0x0F);
+
+    if(!_loaderPath.empty()) {
+        n_res = startLoader(verbose);
+        if(n_res == 0) return programWithLoader(verbose);
+        if(n_res == -2) {
+            // The ROM bootloader has left, only a reset brings it back
+            if(verbose) std::printf("Flash loader doesn't answer\n");
+            return -1;
+        }
+        if(verbose) std::printf("Unable to upload flash loader, using the ROM bootloader\n");
+    }
+
+    if(_package) return programPackage(verbose);
+
+    std::vector<Region> n_regions;
+    imageRegions(n_regions);
+    const uint32_t n_crc = _resume_file_path.empty() ? 0 : imageCrc();
+    const uint32_t n_resume = resumeOffset(n_regions, n_crc);
+
+    if(n_resume > 0) {
+        // Only the pages after the checkpoint, the written part stays
+        if(verbose) std::printf("Resuming at byte %u\n", n_resume);
+        uint32_t n_start = 0;
+        for(const Region &n_region : n_regions) {
+            if(n_resume < n_start + n_region.size) {
+                uint32_t n_pos = (n_resume > n_start) ? n_resume - n_start : 0;
+                n_res = eraseRange(n_region.address + n_pos, n_region.size - n_pos);
+                if(n_res != 0) break;
+            }
+            n_start += n_region.size;
+        }
+    } else {
+        n_res = massErase();
+    }
     if(n_res != 0) {
         if(verbose) {
 
@@ -92,19 +319,283 @@ int STMBoot::programTarget(bool verbose){
         return -1;
     }
 
-    if(verbose) std::printf("Target erased\n");
-
-    if(writeMemory(address, _filecontent, 0, _content_size) != 0){
-        if(verbose) std::printf("Error while programming device\n");
-        return -1;
+    if(verbose) {
+        if(n_resume > 0) std::printf("Remaining pages erased\n");
+        else std::printf("Target erased\n");
     }
-    if(verbose && _progressCallback) std::printf("\n");
+
+    if(writeImage(n_regions, n_resume, n_crc, verbose) != 0) return -1;
+    storeCheckpoint(n_crc, 0);
+    storeVersionCache();
     if(verbose) std::printf("Rebooting device\n");
 
     return reboot();
     //return 0;
 }
 
+void STMBoot::setVersionCache(const std::string filepath){
+    _cache_file_path = filepath;
+    loadVersionCache();
+}
+
+int STMBoot::isTargetCurrent(){
+    if(_package) return 0;     // Packages select images with setPackageFilter()
+
+    int n_res = getDeviceKey(_deviceKey);
+    if(n_res != 0) return n_res;
+
+    if(_filecontent != nullptr && _content_size > 16) {
+        // Compare the trailing header (and CRC) with the one on the target
+        uint32_t n_len = hasCrc() ? 20 : 16;
+        uint8_t n_target[20];
+        uint32_t n_pos = (uint32_t)_content_size - n_len;
+        n_res = readMemory(_baseAddress + n_pos, n_target, n_len);
+        if(n_res != 0) return n_res;
+        if(memcmp(n_target, &_filecontent[n_pos], n_len) != 0) return 0;
+        if(!_deviceKey.empty() && _versionCache.find(_deviceKey) == _versionCache.end()) storeVersionCache();
+        return 1;
+    }
+
+    if(_image.getSegments().empty() || _deviceKey.empty()) return 0;
+    auto n_entry = _versionCache.find(_deviceKey);
+    if(n_entry == _versionCache.end() || n_entry->second != imageCrc()) return 0;
+
+    // Cache hit, check the image to catch devices flashed by other tools. The bootloader
+    // CRC covers the whole first segment without reading it back.
+    const FirmwareImage::Segment &n_first = _image.getSegments().front();
+    uint32_t n_crcLen = (uint32_t)n_first.data.size() & ~3u;
+    if(hasCommand(Commands::GET_CHECKSUM) && n_crcLen > 0) {
+        uint32_t n_crc = 0;
+        n_res = targetCrc(n_first.address, n_crcLen, n_crc);
+        if(n_res != 0) return n_res;
+        return (n_crc == stmCrc32(n_first.data.data(), n_crcLen)) ? 1 : 0;
+    }
+
+    uint8_t n_target[256];
+    uint32_t n_len = (n_first.data.size() > sizeof(n_target)) ? sizeof(n_target) : (uint32_t)n_first.data.size();
+    n_res = readMemory(n_first.address, n_target, n_len);
+    if(n_res != 0) return n_res;
+    return (memcmp(n_target, n_first.data.data(), n_len) == 0) ? 1 : 0;
+}
+
+uint32_t STMBoot::imageCrc(){
+    uint32_t n_crc = 0;
+    if(!_image.getSegments().empty()) {
+        for(const FirmwareImage::Segment &n_segment : _image.getSegments()) {
+            uint8_t n_addr[4];
+            memcpy(n_addr, &n_segment.address, 4);
+            n_crc = crc32(n_addr, 4, n_crc);
+            n_crc = crc32(n_segment.data.data(), (uint32_t)n_segment.data.size(), n_crc);
+        }
+    } else if(_filecontent != nullptr) {
+        n_crc = crc32(_filecontent, (uint32_t)_content_size);
+    }
+    return n_crc;
+}
+
+void STMBoot::loadVersionCache(){
+    _versionCache.clear();
+    std::ifstream n_file(_cache_file_path);
+    if(!n_file.is_open()) return;
+
+    std::string n_key;
+    std::string n_crc;
+    while(n_file >> n_key >> n_crc) {
+        _versionCache[n_key] = (uint32_t)std::stoul(n_crc, nullptr, 16);
+    }
+}
+
+/**
+ * @brief Replace a file so that a crash leaves either the old or the new content.
+ * The content goes to a temporary file first, which is synced and renamed over the original.
+ *
+ * @param path File path
+ * @param content New content
+ * @return Success
+ */
+static int replaceFile(const std::string &path, const std::string &content){
+    const std::string n_temp = path + ".tmp";
+    FILE *n_file = std::fopen(n_temp.c_str(), "wb");
+    if(n_file == nullptr) return -1;
+    bool n_ok = std::fwrite(content.data(), 1, content.size(), n_file) == content.size();
+    n_ok = (std::fflush(n_file) == 0) && n_ok;
+    n_ok = (fsync(fileno(n_file)) == 0) && n_ok;
+    n_ok = (std::fclose(n_file) == 0) && n_ok;
+    if(!n_ok || std::rename(n_temp.c_str(), path.c_str()) != 0) {
+        std::remove(n_temp.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+void STMBoot::storeVersionCache(){
+    if(_cache_file_path.empty() || _deviceKey.empty()) return;
+    _versionCache[_deviceKey] = imageCrc();
+
+    std::string n_content;
+    char n_crc[9];
+    for(const auto &n_entry : _versionCache) {
+        std::snprintf(n_crc, sizeof(n_crc), "%08X", n_entry.second);
+        n_content += n_entry.first + " " + n_crc + "\n";
+    }
+    replaceFile(_cache_file_path, n_content);
+}
+
+void STMBoot::setResumeFile(const std::string filepath){
+    _resume_file_path = filepath;
+    loadCheckpoints();
+}
+
+void STMBoot::loadCheckpoints(){
+    _checkpoints.clear();
+    std::ifstream n_file(_resume_file_path);
+    if(!n_file.is_open()) return;
+
+    std::string n_key;
+    std::string n_crc;
+    std::string n_written;
+    while(n_file >> n_key >> n_crc >> n_written) {
+        _checkpoints[n_key] = { (uint32_t)std::stoul(n_crc, nullptr, 16), (uint32_t)std::stoul(n_written, nullptr, 16) };
+    }
+}
+
+void STMBoot::storeCheckpoint(uint32_t crc, uint32_t written){
+    if(_resume_file_path.empty() || _deviceKey.empty()) return;
+    if(written == 0) {
+        if(_checkpoints.erase(_deviceKey) == 0) return;
+    } else {
+        _checkpoints[_deviceKey] = { crc, written };
+    }
+
+    // Written every CheckpointBlock bytes, a power loss mid-write must not lose the file
+    std::string n_content;
+    char n_line[18];
+    for(const auto &n_entry : _checkpoints) {
+        std::snprintf(n_line, sizeof(n_line), "%08X %08X", n_entry.second.crc, n_entry.second.written);
+        n_content += n_entry.first + " " + n_line + "\n";
+    }
+    replaceFile(_resume_file_path, n_content);
+}
+
+void STMBoot::imageRegions(std::vector<Region> &regions){
+    regions.clear();
+    if(!_image.getSegments().empty()) {
+        for(const FirmwareImage::Segment &n_segment : _image.getSegments())
+            regions.push_back({ n_segment.address, n_segment.data.data(), (uint32_t)n_segment.data.size() });
+    } else if(_filecontent != nullptr) {
+        regions.push_back({ _baseAddress, _filecontent, (uint32_t)_content_size });
+    }
+}
+
+uint32_t STMBoot::pageIndex(uint32_t address) const {
+    if(_chip != nullptr && _chip->pageSize == 0) return _chip->pageOf(address - FlashBase);
+    return (address - FlashBase) / _pageSize;
+}
+
+uint32_t STMBoot::resumeOffset(const std::vector<Region> &regions, uint32_t crc){
+    if(_resume_file_path.empty() || regions.empty() || regions.front().address < FlashBase) return 0;
+    if(_deviceKey.empty() && getDeviceKey(_deviceKey) != 0) return 0;
+    auto n_entry = _checkpoints.find(_deviceKey);
+    if(n_entry == _checkpoints.end() || n_entry->second.crc != crc) return 0;
+
+    uint32_t n_total = 0;
+    for(const Region &n_region : regions) n_total += n_region.size;
+    uint32_t n_resume = n_entry->second.written;
+    if(n_resume > n_total) return 0;
+
+    // Bytes after the checkpoint may be half programmed, their pages are erased
+    // again. The written bytes sharing the first of those pages are written again.
+    uint32_t n_start = 0;
+    for(const Region &n_region : regions) {
+        if(n_resume < n_start + n_region.size) {
+            uint32_t n_page = pageIndex(n_region.address + (n_resume - n_start));
+            n_start = 0;
+            for(const Region &n_first : regions) {
+                if(pageIndex(n_first.address + n_first.size - 1) >= n_page) {
+                    // Pages grow with the address, search the first byte on the page
+                    uint32_t n_low = 0;
+                    uint32_t n_high = n_first.size - 1;
+                    while(n_low < n_high) {
+                        uint32_t n_mid = n_low + (n_high - n_low) / 2;
+                        if(pageIndex(n_first.address + n_mid) >= n_page) n_high = n_mid;
+                        else n_low = n_mid + 1;
+                    }
+                    n_resume = n_start + n_low;
+                    break;
+                }
+                n_start += n_first.size;
+            }
+            break;
+        }
+        n_start += n_region.size;
+    }
+    if(n_resume == 0) return 0;
+
+    // Verify the block before the resume point
+    n_start = 0;
+    for(const Region &n_region : regions) {
+        if(n_resume <= n_start + n_region.size) {
+            uint32_t n_end = n_resume - n_start;
+            uint32_t n_len = (n_end > CheckpointBlock) ? CheckpointBlock : n_end;
+            if(n_len == 0) return 0;
+            return (verifyRange(n_region.address + n_end - n_len, &n_region.data[n_end - n_len], n_len) == 1) ? n_resume : 0;
+        }
+        n_start += n_region.size;
+    }
+    return 0;
+}
+
+int STMBoot::verifyRange(uint32_t address, const uint8_t *data, uint32_t len){
+    int n_res = 0;
+    if(hasCommand(Commands::GET_CHECKSUM) && (address & 3) == 0 && (len & 3) == 0) {
+        uint32_t n_crc = 0;
+        n_res = targetCrc(address, len, n_crc);
+        if(n_res != 0) return n_res;
+        return (n_crc == stmCrc32(data, len)) ? 1 : 0;
+    }
+
+    std::vector<uint8_t> n_target(len);
+    n_res = readMemory(address, n_target.data(), len);
+    if(n_res != 0) return n_res;
+    return (memcmp(n_target.data(), data, len) == 0) ? 1 : 0;
+}
+
+int STMBoot::writeImage(const std::vector<Region> &regions, uint32_t offset, uint32_t crc, bool verbose){
+    uint32_t n_start = 0;
+    for(const Region &n_region : regions) {
+        if(offset < n_start + n_region.size) {
+            uint32_t n_pos = (offset > n_start) ? offset - n_start : 0;
+            if(verbose) std::printf("Writing %u bytes at %08X\n", n_region.size - n_pos, n_region.address + n_pos);
+            while(n_pos < n_region.size) {
+                int n_size = (n_region.size - n_pos > 256) ? 256 : (int)(n_region.size - n_pos);
+                uint8_t *n_data = const_cast<uint8_t*>(n_region.data);
+                int n_offset = (int)n_pos;
+                int n_length = n_size;
+                uint8_t n_padded[256];
+                if(n_size % 4 != 0) {
+                    // WRITE takes whole words, a raw binary file may end within one
+                    memset(n_padded, 0xFF, sizeof(n_padded));
+                    memcpy(n_padded, &n_region.data[n_pos], n_size);
+                    n_data = n_padded;
+                    n_offset = 0;
+                    n_length = (n_size + 3) & ~3;
+                }
+                int n_res = write_addr(n_region.address + n_pos, n_data, n_offset, n_length);
+                if(n_res != 0) {
+                    if(verbose) std::printf("Error while programming device %d\n", n_res);
+                    return -1;
+                }
+                n_pos += n_size;
+                if((n_pos % CheckpointBlock) == 0 || n_pos == n_region.size) storeCheckpoint(crc, n_start + n_pos);
+                if(_progressCallback) _progressCallback(n_region.size, n_pos);
+            }
+            if(verbose && _progressCallback) std::printf("\n");
+        }
+        n_start += n_region.size;
+    }
+    return 0;
+}
+
 void STMBoot::setProgressCallback(std::function<void(uint32_t, uint32_t)> callback){
     _progressCallback = callback;
 }
@@ -184,6 +675,7 @@ int STMBoot::isKnownType(){
     case Signature::SmartControllerFW:
     case Signature::SmartControllerSettings:
     case Signature::SmartSensorFW:
+    case Signature::SmartPackage:
         return 0;
     default:
         return -1;
@@ -198,6 +690,7 @@ int STMBoot::writeMemory(uint32_t addr, uint8_t *buffer, uint32_t offset, uint32
     int n_size = 0;
 
     int n_res = 0;
+    uint8_t n_padded[256];
     
     while(n_len > 0) {
         if(n_len > 256)
@@ -205,8 +698,14 @@ int STMBoot::writeMemory(uint32_t addr, uint8_t *buffer, uint32_t offset, uint32
         else
             n_size = n_len;
 
-
-        n_res = write_addr(n_addr, buffer, n_offset, n_size);
+        if(n_size % 4 != 0) {
+            // Last chunk, WRITE takes whole words
+            memset(n_padded, 0xFF, sizeof(n_padded));
+            memcpy(n_padded, &buffer[n_offset], n_size);
+            n_res = write_addr(n_addr, n_padded, 0, (n_size + 3) & ~3);
+        } else {
+            n_res = write_addr(n_addr, buffer, n_offset, n_size);
+        }
         if( n_res != 0) {
             std::printf("Error: %d\n", n_res);
             return -1;
@@ -235,71 +734,145 @@ uint8_t STMBoot::calcLrc(uint8_t* bffr, int offset, int len, bool invert){
     return invert ? (uint8_t)~n_lrc : n_lrc;
 }
 
+int STMBoot::sendCommand(Commands command){
+    uint8_t n_tx[2];
+    n_tx[0] = (uint8_t)command;
+    n_tx[1] = calcLrc(n_tx);
+    if(transmit(n_tx, 2, 0) != 2) return -1;
+    return waitAck(1.0);
+}
+
 int STMBoot::get(){
-    return 0;
+    if(sendCommand(Commands::GET) != 0) return -1;
+
+    // N, version, N command codes, ACK
+    uint8_t n_bffr[256];
+    if(receiveAll(n_bffr, 1) != 0) return -1;
+    int n_count = n_bffr[0];
+    if(receiveAll(n_bffr, n_count + 1) != 0) return -1;
+
+    _bootVersion = n_bffr[0];
+    _commandList.assign(&n_bffr[1], &n_bffr[1] + n_count);
+    return waitAck(1.0);
 }
 
-int STMBoot::erase(uint8_t pageNo){
-    return 0;
+int STMBoot::getProtection(uint8_t &version, uint8_t &option1, uint8_t &option2){
+    if(sendCommand(Commands::GET_PROT) != 0) return -1;
+
+    uint8_t n_rx[3];
+    if(receiveAll(n_rx, 3) != 0) return -1;
+    version = n_rx[0];
+    option1 = n_rx[1];
+    option2 = n_rx[2];
+    return waitAck(1.0);
 }
 
-int STMBoot::extendedErase(){
-    usleep(10000);
-    uint8_t n_tx[2];
-    uint8_t n_rx;
+bool STMBoot::hasCommand(Commands command) const {
+    for(uint8_t n_code : _commandList) {
+        if(n_code == (uint8_t)command) return true;
+    }
+    return false;
+}
 
+STMBoot::Commands STMBoot::eraseCommand() const {
+    if(hasCommand(Commands::NS_EXT_ERASE)) return Commands::NS_EXT_ERASE;
+    if(hasCommand(Commands::ERASE) && !hasCommand(Commands::EXT_ERASE)) return Commands::ERASE;
+    return Commands::EXT_ERASE;
+}
+
+int STMBoot::erase(uint16_t firstPage, uint16_t count){
+    uint8_t n_tx[2 + MaxErasePages * 2 + 1];
+    const Commands n_cmd = eraseCommand();
+    const bool n_legacy = (n_cmd == Commands::ERASE);
+    // Sectors take up to a couple of seconds each, pages a few milli seconds
+    const double n_perPage = (_chip != nullptr && _chip->pageSize == 0) ? 2.0 : 0.05;
     int n_res = 0;
-    int n_return = -1;
-    n_tx[0] = (uint8_t)Commands::EXT_ERASE;
-    n_tx[1] = calcLrc(n_tx, 0, 1);
 
-    n_res = transmit(n_tx, 2, 0);
-    if(n_res != 2) return -1;
-    usleep(10000);
-    n_res = receive(&n_rx, 1, 0);
+    if(n_legacy && firstPage + count > 256) return -1;    // One byte page numbers
 
-    if(n_res != 1 || n_rx != (uint8_t)Response::ACK) return -1;
-    usleep(10000);
-    time_t n_start;
-    time_t n_now;
-    time(&n_start);
-    time(&n_now);
+    while(count > 0) {
+        uint16_t n_pages = (count > MaxErasePages) ? MaxErasePages : count;
 
-    uint8_t n_tx2[3];
-    n_tx2[0] = n_tx2[1] = 0xFF;
-    n_tx2[2] = 0xFF;
-    n_res = transmit(n_tx2, 3, 0);
+        if(sendCommand(n_cmd) != 0) return -1;
 
-    if(n_res != 3) return -1;
+        // Number of pages - 1 followed by the page numbers, MSB first (one byte each for legacy erase)
+        int n_len = 0;
+        if(!n_legacy) n_tx[n_len++] = (uint8_t)((n_pages - 1) >> 8);
+        n_tx[n_len++] = (uint8_t)((n_pages - 1) & 0xFF);
+        for(uint16_t n_index = 0; n_index < n_pages; n_index++) {
+            uint16_t n_page = firstPage + n_index;
+            if(!n_legacy) n_tx[n_len++] = (uint8_t)(n_page >> 8);
+            n_tx[n_len++] = (uint8_t)(n_page & 0xFF);
+        }
+        n_tx[n_len] = calcLrc(n_tx, 0, n_len);
+        n_len++;
+
+        n_res = transmit(n_tx, n_len, 0);
+        if(n_res != n_len) return -1;
+        n_res = waitAck(10.0 + n_perPage * n_pages);
+        if(n_res != 0) return n_res;
+
+        firstPage += n_pages;
+        count -= n_pages;
+    }
+    return 0;
+}
+
+int STMBoot::eraseRange(uint32_t address, uint32_t len){
+    if(address < FlashBase || len == 0) return -1;
+    if(_chip != nullptr && _chip->pageSize == 0) {
+        // Sector organised flash
+        uint16_t n_first = 0;
+        uint16_t n_count = 0;
+        if(_chip->pageRange(address - FlashBase, len, n_first, n_count) != 0) return -1;
+        return erase(n_first, n_count);
+    }
+    uint32_t n_first = (address - FlashBase) / _pageSize;
+    uint32_t n_last = (address - FlashBase + len - 1) / _pageSize;
+    return erase((uint16_t)n_first, (uint16_t)(n_last - n_first + 1));
+}
+
+int STMBoot::waitAck(double timeoutSec){
+    // Wake on the byte instead of polling, the ACK is taken as soon as it arrives
+    const auto n_end = std::chrono::steady_clock::now() + std::chrono::microseconds((int64_t)(timeoutSec * 1000000.0));
+    uint8_t n_rx = 0;
+    while(true) {
+        int n_left = (int)std::chrono::duration_cast<std::chrono::milliseconds>(n_end - std::chrono::steady_clock::now()).count();
+        if(n_left < 0) return -2;
+        int n_res = waitReadable(n_left + 1);
+        if(n_res < 0) return -1;
+        if(n_res == 0) continue;
 
-    n_rx = 0;
-    while (true)
-    {
         n_res = receive(&n_rx, 1, 0);
-        if(n_res == 1){
-            if(n_rx == (uint8_t)Response::ACK) {
-                n_return = 0;
-            }
-            break;
-        }
+        if(n_res == 1 && n_rx != (uint8_t)Response::BUSY) return (n_rx == (uint8_t)Response::ACK) ? 0 : -1;
+    }
+}
 
-        time(&n_now);
-        if(difftime(n_now, n_start) > 40.0) {
-            n_return = -2;
-            break;
-        }
-        usleep(100);
+int STMBoot::massErase(){
+    const Commands n_cmd = eraseCommand();
+    if(sendCommand(n_cmd) != 0) return -1;
+
+    // Legacy erase: 0xFF and its complement, extended erase: 0xFFFF and checksum
+    uint8_t n_tx[3];
+    int n_len = 0;
+    n_tx[n_len++] = 0xFF;
+    if(n_cmd == Commands::ERASE) {
+        n_tx[n_len++] = 0x00;
+    } else {
+        n_tx[n_len++] = 0xFF;
+        n_tx[n_len] = calcLrc(n_tx, 0, n_len);
+        n_len++;
     }
-    return n_return;
+    if(transmit(n_tx, n_len, 0) != n_len) return -1;
+    return waitAck(40.0);
 }
 
 int STMBoot::write_addr(uint32_t address, uint8_t *buffer, int offset, int length){
-    uint8_t n_rx = 0;
     uint8_t n_tx[9];
     int n_res = 0;
 
-    // Set write command
-    n_tx[0] = (uint8_t)Commands::WRITE;
+    // Set write command, the no-stretch variant when the bootloader has it
+    n_tx[0] = (uint8_t)(hasCommand(Commands::NS_WRITE) ? Commands::NS_WRITE : Commands::WRITE);
     n_tx[1] = calcLrc(n_tx);
 
     // Set address
@@ -316,16 +889,12 @@ int STMBoot::write_addr(uint32_t address, uint8_t *buffer, int offset, int lengt
     // Transmit initial command
     n_res = transmit(n_tx, 2, 0);
     if(n_res != 2) return -18;
-    usleep(500);
-    n_res = receive(&n_rx, 1, 0);
-    if(n_res != 1 || n_rx != (uint8_t)Response::ACK) return -1;
+    if(waitAck(ShortAckSec) != 0) return -1;
         
     // Transmit address
     n_res = transmit(n_tx, 5, 2);
     if(n_res != 5) return -19;
-    usleep(500);
-    n_res = receive(&n_rx, 1, 0);
-    if(n_res != 1 || n_rx != (uint8_t)Response::ACK) return -2;
+    if(waitAck(ShortAckSec) != 0) return -2;
 
 
     // Transmit data
@@ -337,32 +906,432 @@ int STMBoot::write_addr(uint32_t address, uint8_t *buffer, int offset, int lengt
 
     n_res = transmit(&n_tx[8], 1, 0);
     if(n_res != 1) return -22;
-    usleep(500);
-    n_res = receive(&n_rx, 1, 0);
-
-    if(n_res != 1 || n_rx != (uint8_t)Response::ACK) return -3;
-    return 0;
+    return (waitAck(1.0) == 0) ? 0 : -3;
 }
 
 int STMBoot::read_addr(uint32_t address, uint8_t *buffer, int offset, int length){
+    uint8_t n_tx[7];
+    int n_res = 0;
+
+    // Set read command
+    n_tx[0] = (uint8_t)Commands::READ;
+    n_tx[1] = calcLrc(n_tx);
+
+    // Set address
+    n_tx[2] = (uint8_t)((address >> 24) & 0xff);
+    n_tx[3] = (uint8_t)((address >> 16) & 0xff);
+    n_tx[4] = (uint8_t)((address >> 8) & 0xff);
+    n_tx[5] = (uint8_t)(address & 0xff);
+    n_tx[6] = calcLrc(n_tx, 2, 4);
+
+    n_res = transmit(n_tx, 2, 0);
+    if(n_res != 2) return -18;
+    if(waitAck(ShortAckSec) != 0) return -1;
+
+    n_res = transmit(n_tx, 5, 2);
+    if(n_res != 5) return -19;
+    if(waitAck(ShortAckSec) != 0) return -2;
+
+    // Number of bytes - 1 and its complement
+    n_tx[0] = (uint8_t)(length - 1);
+    n_tx[1] = calcLrc(n_tx);
+    n_res = transmit(n_tx, 2, 0);
+    if(n_res != 2) return -20;
+    if(waitAck(ShortAckSec) != 0) return -3;
+
+    return receiveAll(&buffer[offset], length);
+}
+
+int STMBoot::readMemory(uint32_t addr, uint8_t *buffer, uint32_t len){
+    uint32_t n_offset = 0;
+    while(n_offset < len) {
+        int n_size = ((len - n_offset) > 256) ? 256 : (int)(len - n_offset);
+        int n_res = read_addr(addr + n_offset, buffer, n_offset, n_size);
+        if(n_res != 0) return -1;
+        n_offset += n_size;
+    }
     return 0;
 }
 
-int STMBoot::go(uint32_t address){
+int STMBoot::receiveAll(uint8_t *buffer, int len){
+    int n_received = 0;
+    while(n_received < len) {
+        // receive() returns 0 when the read timeout expires
+        int n_res = receive(buffer, len - n_received, n_received);
+        if(n_res <= 0) return -4;
+        n_received += n_res;
+    }
     return 0;
 }
 
-int STMBoot::reboot(){
-    uint8_t n_rx;
+int STMBoot::getId(uint16_t &pid){
+    uint8_t n_rx[4];
     uint8_t n_tx[2];
-    n_tx[0] = (uint8_t)Commands::REBOOT;
-    n_tx[1] = calcLrc(&n_tx[0], 0, 1);
 
+    n_tx[0] = (uint8_t)Commands::GET_ID;
+    n_tx[1] = calcLrc(n_tx);
     int n_res = transmit(n_tx, 2, 0);
     if(n_res != 2) return -1;
-    usleep(100);
-    n_res = receive(&n_rx, 1, 0);
-    if(n_res != 1 || n_rx != (uint8_t)Response::ACK) return -1;
 
+    // ACK, N (= 1), PID MSB, PID LSB
+    n_res = receiveAll(n_rx, 4);
+    if(n_res != 0 || n_rx[0] != (uint8_t)Response::ACK || n_rx[1] != 1) return -1;
+    pid = (uint16_t)((n_rx[2] << 8) | n_rx[3]);
+
+    n_res = receiveAll(n_rx, 1);
+    if(n_res != 0 || n_rx[0] != (uint8_t)Response::ACK) return -1;
+    return 0;
+}
+
+int STMBoot::getDeviceKey(std::string &key){
+    key.clear();
+    if(identify() != 0) return -1;
+    if(_chip == nullptr || _chip->uidAddress == 0) return 0;    // Unknown family, not unique
+
+    uint8_t n_uid[12];
+    if(readMemory(_chip->uidAddress, n_uid, sizeof(n_uid)) != 0) return -1;
+
+    char n_key[3 + 1 + 24 + 1];
+    int n_len = std::snprintf(n_key, sizeof(n_key), "%03X:", _pid);
+    for(int n_index = 0; n_index < 12; n_index++) {
+        n_len += std::snprintf(&n_key[n_len], sizeof(n_key) - n_len, "%02X", n_uid[n_index]);
+    }
+    key = n_key;
+    return 0;
+}
+
+uint32_t STMBoot::crc32(const uint8_t *bffr, uint32_t len, uint32_t crc){
+    static uint32_t s_table[256];
+    static bool s_init = false;
+    if(!s_init) {
+        for(uint32_t n_index = 0; n_index < 256; n_index++) {
+            uint32_t n_value = n_index;
+            for(int n_bit = 0; n_bit < 8; n_bit++) n_value = (n_value & 1) ? (0xEDB88320 ^ (n_value >> 1)) : (n_value >> 1);
+            s_table[n_index] = n_value;
+        }
+        s_init = true;
+    }
+
+    crc = ~crc;
+    for(uint32_t n_pos = 0; n_pos < len; n_pos++) crc = s_table[(crc ^ bffr[n_pos]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+int STMBoot::targetCrc(uint32_t address, uint32_t len, uint32_t &crc){
+    if(len == 0 || (len & 3) != 0) return -1;
+    if(sendCommand(Commands::GET_CHECKSUM) != 0) return -1;
+
+    // Address, size, polynomial and initial value, each MSB first with XOR checksum
+    const uint32_t n_fields[4] = { address, len, 0x04C11DB7, 0xFFFFFFFF };
+    uint8_t n_tx[5];
+    for(uint32_t n_field : n_fields) {
+        n_tx[0] = (uint8_t)((n_field >> 24) & 0xff);
+        n_tx[1] = (uint8_t)((n_field >> 16) & 0xff);
+        n_tx[2] = (uint8_t)((n_field >> 8) & 0xff);
+        n_tx[3] = (uint8_t)(n_field & 0xff);
+        n_tx[4] = calcLrc(n_tx, 0, 4);
+        if(transmit(n_tx, 5, 0) != 5) return -1;
+        if(waitAck(1.0) != 0) return -1;
+    }
+
+    // The bootloader needs about 1 ms per 8K before it replies
+    if(waitAck(1.0 + len / (8.0 * 1024 * 1000)) != 0) return -1;
+    uint8_t n_rx[5];
+    if(receiveAll(n_rx, 5) != 0) return -1;
+    if(calcLrc(n_rx, 0, 4) != n_rx[4]) return -1;
+    crc = ((uint32_t)n_rx[0] << 24) | ((uint32_t)n_rx[1] << 16) | ((uint32_t)n_rx[2] << 8) | n_rx[3];
     return 0;
 }
+
+uint32_t STMBoot::stmCrc32(const uint8_t *bffr, uint32_t len){
+    uint32_t n_crc = 0xFFFFFFFF;
+    for(uint32_t n_pos = 0; n_pos + 4 <= len; n_pos += 4) {
+        // The CRC unit is fed the word as the core reads it (little endian), MSB first
+        uint32_t n_word = (uint32_t)bffr[n_pos] | ((uint32_t)bffr[n_pos + 1] << 8) |
+                          ((uint32_t)bffr[n_pos + 2] << 16) | ((uint32_t)bffr[n_pos + 3] << 24);
+        n_crc ^= n_word;
+        for(int n_bit = 0; n_bit < 32; n_bit++) n_crc = (n_crc & 0x80000000) ? ((n_crc << 1) ^ 0x04C11DB7) : (n_crc << 1);
+    }
+    return n_crc;
+}
+
+int STMBoot::go(uint32_t address){
+    uint8_t n_tx[7];
+
+    n_tx[0] = (uint8_t)Commands::GO;
+    n_tx[1] = calcLrc(n_tx);
+
+    n_tx[2] = (uint8_t)((address >> 24) & 0xff);
+    n_tx[3] = (uint8_t)((address >> 16) & 0xff);
+    n_tx[4] = (uint8_t)((address >> 8) & 0xff);
+    n_tx[5] = (uint8_t)(address & 0xff);
+    n_tx[6] = calcLrc(n_tx, 2, 4);
+
+    int n_res = transmit(n_tx, 2, 0);
+    if(n_res != 2) return -1;
+    if(waitAck(ShortAckSec) != 0) return -1;
+
+    n_res = transmit(n_tx, 5, 2);
+    if(n_res != 5) return -1;
+    if(waitAck(ShortAckSec) != 0) return -1;
+
+    return 0;
+}
+
+/** @brief Store a 32 bit value little endian */
+static void putLe32(uint8_t *bffr, uint32_t value){
+    bffr[0] = (uint8_t)(value & 0xff);
+    bffr[1] = (uint8_t)((value >> 8) & 0xff);
+    bffr[2] = (uint8_t)((value >> 16) & 0xff);
+    bffr[3] = (uint8_t)((value >> 24) & 0xff);
+}
+
+/** @brief Read a 32 bit little endian value */
+static uint32_t getLe32(const uint8_t *bffr){
+    return (uint32_t)bffr[0] | ((uint32_t)bffr[1] << 8) | ((uint32_t)bffr[2] << 16) | ((uint32_t)bffr[3] << 24);
+}
+
+int STMBoot::startLoader(bool verbose){
+    std::ifstream n_file(_loaderPath, std::ios::binary);
+    if(!n_file.is_open()) return -1;
+    std::vector<uint8_t> n_loader((std::istreambuf_iterator<char>(n_file)), std::istreambuf_iterator<char>());
+    if(n_loader.size() < 8) return -1;
+
+    // The image and the stack its vector table points to have to fit in SRAM
+    // above the part the ROM bootloader uses
+    uint32_t n_address = _loaderAddress;
+    const uint32_t n_size = (uint32_t)n_loader.size();
+    if(_chip == nullptr) {
+        if(n_address == FlashLoader::AutoAddress) return -1;   // RAM layout unknown
+    } else {
+        const uint32_t n_low = STMChip::RamBase + _chip->bootRam;
+        const uint32_t n_high = STMChip::RamBase + _chip->ramSize;
+        const uint32_t n_sp = getLe32(n_loader.data());
+        if(n_address == FlashLoader::AutoAddress) n_address = n_low;
+        if(n_address < n_low || n_address + n_size > n_high || n_sp <= n_address + n_size || n_sp > n_high) {
+            if(verbose) std::printf("Flash loader doesn't fit in the %u KB SRAM of the %s\n", _chip->ramSize / 1024, _chip->name);
+            return -1;
+        }
+    }
+
+    if(verbose) std::printf("Uploading flash loader (%u bytes) to %08X\n", n_size, n_address);
+    if(writeMemory(n_address, n_loader.data(), 0, n_size) != 0) return -1;
+    if(verbose && _progressCallback) std::printf("\n");
+    if(go(n_address) != 0) return -1;
+
+    // Give the loader time to set up its clocks
+    std::vector<uint8_t> n_reply;
+    int n_res = -1;
+    for(int n_attempt = 0; n_attempt < 10 && n_res != 0; n_attempt++) {
+        usleep(20000);
+        n_res = loaderRequest(FlashLoader::Command::PING, nullptr, 0, n_reply, 100);
+    }
+    if(n_res != 0 || n_reply.size() < 5) return -2;
+
+    const uint32_t n_maxBlock = FlashLoader::MaxPayload - 4;
+    _loaderBlock = getLe32(&n_reply[1]);
+    if(_loaderBlock == 0 || _loaderBlock > n_maxBlock) _loaderBlock = n_maxBlock;
+    _loaderBlock &= ~7u;    // Whole flash double words
+    if(_loaderBlock == 0) return -2;
+    _loaderFeatures = (n_reply.size() > 5) ? n_reply[5] : 0;
+    if(verbose) std::printf("Flash loader v%d running, %u byte blocks%s\n", n_reply[0], _loaderBlock,
+                            (_loaderFeatures & FlashLoader::FeatureLz4) ? ", LZ4" : "");
+
+    if(_loaderBitrate > 0) {
+        uint8_t n_payload[4];
+        putLe32(n_payload, (uint32_t)_loaderBitrate);
+        if(loaderRequest(FlashLoader::Command::SET_BAUD, n_payload, 4, n_reply, 100) != 0) return -2;
+        if(setBitrate(_loaderBitrate) != 0) return -2;
+        usleep(10000);
+        if(loaderRequest(FlashLoader::Command::PING, nullptr, 0, n_reply, 100) != 0) return -2;
+        if(verbose) std::printf("Switched to %d bps\n", _loaderBitrate);
+    }
+    return 0;
+}
+
+int STMBoot::programWithLoader(bool verbose){
+    std::vector<Region> n_regions;
+
+    if(_package) {
+        for(const SmartPackage::Entry &n_entry : _package->getEntries()) {
+            if(!_packageFilter || _packageFilter(n_entry.signature, n_entry.major, n_entry.minor, n_entry.build))
+                n_regions.push_back({ n_entry.address, _package->getData(n_entry), n_entry.size });
+        }
+        if(n_regions.empty() && verbose) std::printf("All images up to date\n");
+    } else {
+        imageRegions(n_regions);
+    }
+
+    int n_res = loaderErase(n_regions);
+    if(n_res != 0) {
+        if(verbose) std::printf("Error while erasing %d\n", n_res);
+        return -1;
+    }
+
+    for(const Region &n_region : n_regions) {
+        if(verbose) std::printf("Writing %u bytes at %08X\n", n_region.size, n_region.address);
+        n_res = loaderProgram(n_region.address, n_region.data, n_region.size);
+        if(verbose && _progressCallback) std::printf("\n");
+        if(n_res != 0) {
+            if(verbose) std::printf("Error while programming device %d\n", n_res);
+            return -1;
+        }
+    }
+
+    if(!_package) storeVersionCache();
+    if(verbose) std::printf("Rebooting device\n");
+    std::vector<uint8_t> n_reply;
+    return (loaderRequest(FlashLoader::Command::RESET, nullptr, 0, n_reply, 500) == 0) ? 0 : -1;
+}
+
+void STMBoot::eraseRanges(const std::vector<Region> &regions, std::vector<Region> &ranges) const {
+    std::vector<Region> n_sorted;
+    for(const Region &n_region : regions) {
+        if(n_region.size > 0) n_sorted.push_back(n_region);
+    }
+    std::sort(n_sorted.begin(), n_sorted.end(), [](const Region &a, const Region &b){
+        return a.address < b.address;
+    });
+
+    // Regions sharing a page are erased as one range, erasing per region would
+    // wipe what the previous region wrote to the shared page
+    ranges.clear();
+    size_t n_index = 0;
+    while(n_index < n_sorted.size()) {
+        const uint32_t n_start = n_sorted[n_index].address;
+        uint32_t n_end = n_start + n_sorted[n_index].size;
+        for(n_index++; n_index < n_sorted.size(); n_index++) {
+            const Region &n_next = n_sorted[n_index];
+            if(n_start < FlashBase || pageIndex(n_next.address) > pageIndex(n_end - 1)) break;
+            if(n_next.address + n_next.size > n_end) n_end = n_next.address + n_next.size;
+        }
+        ranges.push_back({ n_start, nullptr, n_end - n_start });
+    }
+}
+
+int STMBoot::loaderErase(const std::vector<Region> &regions){
+    std::vector<Region> n_ranges;
+    std::vector<uint8_t> n_reply;
+    eraseRanges(regions, n_ranges);
+    for(const Region &n_range : n_ranges) {
+        uint8_t n_bytes[8];
+        putLe32(n_bytes, n_range.address);
+        putLe32(&n_bytes[4], n_range.size);
+        // Up to 2 s per 128K sector on sector organised flash
+        int n_res = loaderRequest(FlashLoader::Command::ERASE, n_bytes, 8, n_reply, 5000 + (int)(n_range.size / 1024) * 20);
+        if(n_res != 0) return n_res;
+    }
+    return 0;
+}
+
+int STMBoot::loaderProgram(uint32_t address, const uint8_t *data, uint32_t len){
+    std::vector<uint8_t> n_reply;
+    uint8_t n_range[8];
+    putLe32(n_range, address);
+    putLe32(&n_range[4], len);
+    int n_res = 0;
+
+    const bool n_lz4 = (_loaderFeatures & FlashLoader::FeatureLz4) != 0;
+    std::vector<uint8_t> n_payload(12 + _loaderBlock);
+    uint32_t n_done = 0;
+    while(n_done < len) {
+        uint32_t n_size = (len - n_done > _loaderBlock) ? _loaderBlock : len - n_done;
+        FlashLoader::Command n_cmd = FlashLoader::Command::WRITE;
+        uint32_t n_payloadLen = 4 + n_size;
+        putLe32(n_payload.data(), address + n_done);
+
+        // Compressed blocks also carry the CRC of the raw data, the loader checks its output
+        const std::vector<uint8_t> *n_packed = nullptr;
+        uint32_t n_crc = 0;
+        if(n_lz4) {
+            n_crc = crc32(data + n_done, n_size);
+            n_packed = &compressedBlock(address + n_done, data + n_done, n_size, n_crc);
+        }
+        if(n_packed != nullptr && !n_packed->empty() && n_packed->size() + 8 < n_size) {
+            n_cmd = FlashLoader::Command::WRITE_LZ4;
+            putLe32(&n_payload[4], n_size);
+            putLe32(&n_payload[8], n_crc);
+            memcpy(&n_payload[12], n_packed->data(), n_packed->size());
+            n_payloadLen = 12 + (uint32_t)n_packed->size();
+        } else {
+            memcpy(&n_payload[4], data + n_done, n_size);
+        }
+
+        // The frame CRC protects the block, a damaged block is sent again
+        n_res = loaderRequest(n_cmd, n_payload.data(), n_payloadLen, n_reply, 2000);
+        if(n_res == -1 || n_res == -2) n_res = loaderRequest(n_cmd, n_payload.data(), n_payloadLen, n_reply, 2000);
+        if(n_res != 0) return n_res;
+        n_done += n_size;
+        if(_progressCallback) _progressCallback(len, n_done);
+    }
+
+    n_res = loaderRequest(FlashLoader::Command::CRC, n_range, 8, n_reply, 1000 + (int)(len / 1024));
+    if(n_res != 0) return n_res;
+    if(n_reply.size() < 4 || getLe32(n_reply.data()) != crc32(data, len)) return -4;
+    return 0;
+}
+
+const std::vector<uint8_t> &STMBoot::compressedBlock(uint32_t address, const uint8_t *data, uint32_t len, uint32_t crc){
+    CompressedBlock &n_block = _compressedBlocks[address];
+    if(n_block.length != len || n_block.crc != crc || n_block.data.empty()) {
+        n_block.length = len;
+        n_block.crc = crc;
+        LZ4Block::compress(data, len, n_block.data);
+
+        // Nothing on the host side reads the format, so every block is decoded
+        // again here. A block that doesn't round trip is sent uncompressed.
+        std::vector<uint8_t> n_check(len);
+        if(LZ4Block::decompress(n_block.data.data(), (uint32_t)n_block.data.size(), n_check.data(), len) != (int)len ||
+           memcmp(n_check.data(), data, len) != 0) {
+            n_block.data.clear();
+        }
+    }
+    return n_block.data;
+}
+
+int STMBoot::loaderRequest(FlashLoader::Command command, const uint8_t *payload, uint32_t len,
+                           std::vector<uint8_t> &reply, int timeoutMs){
+    if(len > FlashLoader::MaxPayload) return -1;
+    std::vector<uint8_t> n_frame(len + FlashLoader::FrameOverhead);
+    n_frame[0] = FlashLoader::Sof;
+    n_frame[1] = (uint8_t)command;
+    n_frame[2] = (uint8_t)(len & 0xff);
+    n_frame[3] = (uint8_t)(len >> 8);
+    if(len > 0) memcpy(&n_frame[4], payload, len);
+    putLe32(&n_frame[4 + len], crc32(&n_frame[1], 3 + len));
+    if(transmitAll(n_frame.data(), (int)n_frame.size()) != (int)n_frame.size()) return -1;
+
+    uint8_t n_head[4];
+    int n_res = receiveTimed(n_head, 4, timeoutMs);
+    if(n_res != 0) return n_res;
+    if(n_head[0] != FlashLoader::Sof) return -1;
+
+    uint32_t n_len = (uint32_t)n_head[2] | ((uint32_t)n_head[3] << 8);
+    reply.resize(n_len + 4);
+    n_res = receiveTimed(reply.data(), (int)reply.size(), timeoutMs);
+    if(n_res != 0) return n_res;
+
+    uint32_t n_crc = crc32(&n_head[1], 3);
+    n_crc = crc32(reply.data(), n_len, n_crc);
+    if(n_crc != getLe32(&reply[n_len])) return -1;
+    reply.resize(n_len);
+    return (n_head[1] == (uint8_t)FlashLoader::Status::OK) ? 0 : -3;
+}
+
+int STMBoot::receiveTimed(uint8_t *buffer, int len, int timeoutMs){
+    const std::chrono::steady_clock::time_point n_end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    int n_received = 0;
+    while(n_received < len) {
+        int n_left = (int)std::chrono::duration_cast<std::chrono::milliseconds>(n_end - std::chrono::steady_clock::now()).count();
+        if(n_left < 0 || waitReadable(n_left) <= 0) return -2;
+        int n_res = receive(buffer, len - n_received, n_received);
+        if(n_res < 0) return -1;
+        n_received += n_res;
+    }
+    return 0;
+}
+
+int STMBoot::reboot(){
+    // Start the application, the bootloader loads SP and PC from its vector table
+    return go(_baseAddress);
+}
@@ -12,9 +12,17 @@
 #define _STMBOOT_H_
 
 #include "../uart/serial.h"
+#include "firmwareimage.h"
+#include "stmchips.h"
+#include "flashloader.h"
 #include <fstream>
 #include <string>
 #include <functional>
+#include <memory>
+#include <map>
+#include <vector>
+
+class SmartPackage;
 
 class STMBoot : public Serial {
     public:
@@ -30,20 +38,24 @@ class STMBoot : public Serial {
         GET_PROT        = 0x01,   /*!< Get version, and read protection status */
         GET_ID          = 0x02,   /*!< Get chip ID */
         READ            = 0x11,   /*!< Rread memory (max 256 bytes) */
-        GO              = 0x21,   /*!< Jump to address in memory. This function is currently not available */
+        GO              = 0x21,   /*!< Jump to address in memory */
         WRITE           = 0x31,   /*!< Write data to memeory (max 256 bytes) */
-        ERASE           = 0x43,   /*!< Erase memeory page wise (currently just erases all memory area) */
-        EXT_ERASE       = 0x44,   /*!< Erase memory */
+        NS_WRITE        = 0x32,   /*!< No-stretch write, replies BUSY until done */
+        ERASE           = 0x43,   /*!< Erase memeory page wise, one byte page numbers (bootloader v2.x and older) */
+        EXT_ERASE       = 0x44,   /*!< Erase memory, two byte page numbers */
+        NS_EXT_ERASE    = 0x45,   /*!< No-stretch extended erase, replies BUSY until done */
         WR_PROTECT      = 0x63,   /*!< Enable write protection */
         WR_UNPROTECT    = 0x73,   /*!< Disable write protection */
         RD_PROTECT      = 0x82,   /*!< Enable read protection */
         RD_UNPROTECT    = 0x92,   /*!< Disable read protection */
+        GET_CHECKSUM    = 0xA1,   /*!< CRC of a memory area, calculated by the bootloader */
     };
 
     /** @brief Protocol reponses */
     enum class Response {
         ACK     = 0x79,
-        NACK    = 0x1F
+        NACK    = 0x1F,
+        BUSY    = 0x76      /*!< No-stretch command still running */
     };
 
     /** @brief File signatures */
@@ -89,6 +101,22 @@ class STMBoot : public Serial {
      */
     int setBinaryFile(const std::string filepath);
 
+    /**
+     * @brief Set an image file (Intel HEX, S-record, ELF or raw binary) to transfere.
+     * Only the address ranges present in the file are written.
+     * 
+     * @param filepath Path to file
+     * @return Success
+     */
+    int setImageFile(const std::string filepath);
+
+    /**
+     * @brief Set the load address used for raw binary files
+     * 
+     * @param address Flash address
+     */
+    void setBaseAddress(uint32_t address);
+
     /**
      * @brief Get the Header from file
      * 
@@ -105,6 +133,101 @@ class STMBoot : public Serial {
      */
     int programTarget(bool verbose=false);    
 
+    /**
+     * @brief Run programTarget() in real-time mode (see RealTime): the calling thread
+     * runs SCHED_FIFO and the image is prefaulted. Memory locking is up to the
+     * application, ie. RealTime::lockMemory() at start up.
+     * 
+     * @param priority SCHED_FIFO priority, 0 for the default scheduler
+     */
+    void setRealTime(const int priority);
+
+    /**
+     * @brief Set the file used to remember what was last flashed on each device.
+     * Entries are keyed by product ID and the 96 bit unique device ID.
+     * 
+     * @param filepath Path to cache file
+     */
+    void setVersionCache(const std::string filepath);
+
+    /**
+     * @brief Check if the target already runs the selected image.
+     * Must be called after init(). Images with a header are compared against the header
+     * read back from the target, other images against the version cache.
+     * 
+     * @return 1 if current, 0 if it needs programming, negative on communication error
+     */
+    int isTargetCurrent();
+
+    /**
+     * @brief Set the file holding write progress per device.
+     * A target that dropped off mid-flash continues after the last verified block
+     * instead of being erased and written again. Entries are keyed like the version
+     * cache and only match the same image. Applies to the ROM bootloader path.
+     * 
+     * @param filepath Path to progress file
+     */
+    void setResumeFile(const std::string filepath);
+
+    /**
+     * @brief Set which images of a smart package to flash.
+     * Without a filter all images are flashed.
+     * 
+     * @param filter Returns true for images that need updating (signature, major, minor, build)
+     */
+    void setPackageFilter(std::function<bool(Signature, uint8_t, uint8_t, uint16_t)> filter);
+
+    /**
+     * @brief Set the flash page size used for page erase, overrides the chip database
+     * 
+     * @param pageSize Page size in bytes
+     */
+    void setPageSize(uint32_t pageSize);
+
+    /**
+     * @brief Program through a RAM resident flash loader (see flashloader.h) instead of
+     * the ROM bootloader WRITE command. The ROM path is used if the upload fails.
+     * 
+     * @param filepath Loader binary, empty to disable
+     * @param address SRAM load and start address, AutoAddress to place it above the ROM
+     * bootloader's RAM. Unknown chips need an explicit address.
+     * @param bitrate Bitrate to switch to once the loader runs, 0 to keep the current one
+     */
+    void setFlashLoader(const std::string filepath, uint32_t address=FlashLoader::AutoAddress, int bitrate=0);
+
+    /**
+     * @brief Read the bootloader version, its command list and the chip ID.
+     * Must be called after init(), programTarget() and isTargetCurrent() call it when needed.
+     * The result selects the erase command, page geometry and verification method.
+     * 
+     * @return Success
+     */
+    int identify();
+
+    /**
+     * @brief Get the chip found by identify()
+     * 
+     * @return Chip database entry or nullptr if unknown
+     */
+    const STMChip *getChip() const;
+
+    /**
+     * @brief Get the bootloader version found by identify(), ie. 0x31 for v3.1
+     * 
+     * @return Version, 0 if not identified
+     */
+    uint8_t getBootloaderVersion() const;
+
+    /**
+     * @brief Read the bootloader version and read protection option bytes (GET_PROT)
+     * 
+     * @param version Reference to bootloader version
+     * @param option1 Reference to option byte 1
+     * @param option2 Reference to option byte 2
+     * @return Success
+     */
+    int getProtection(uint8_t &version, uint8_t &option1, uint8_t &option2);
+
     /**
      * @brief Set the Progress Callback object
      * 
@@ -113,6 +236,16 @@ class STMBoot : public Serial {
     void setProgressCallback(std::function<void(uint32_t, uint32_t)> callback);
 
     private:
+    /** @brief Bytes written between progress checkpoints */
+    static const uint32_t CheckpointBlock = 4096;
+
+    /** @brief Flash range of the selected image */
+    struct Region {
+        uint32_t address;
+        const uint8_t *data;
+        uint32_t size;
+    };
+
     /**
      * @brief Check if file has a CRC 
      * 
@@ -135,7 +268,8 @@ class STMBoot : public Serial {
     int loadFileContent();
 
     /**
-     * @brief Write data to target
+     * @brief Write data to target.
+     * A final chunk that doesn't end on a word is padded with 0xFF, WRITE takes whole words.
      * 
      * @param addr Write address
      * @param buffer Pointer to buffer
@@ -156,10 +290,301 @@ class STMBoot : public Serial {
      */
     uint8_t calcLrc(uint8_t* bffr, int offset=0, int len=1, bool invert=true);
 
+    /**
+     * @brief Read the bootloader version and supported commands (GET)
+     * 
+     * @return Success
+     */
     int get();
 
-    int erase(uint8_t pageNo);
-    int extendedErase();
+    /**
+     * @brief Check if the bootloader listed a command in its GET reply
+     * 
+     * @param command Command
+     * @return Result, false if GET wasn't read
+     */
+    bool hasCommand(Commands command) const;
+
+    /**
+     * @brief Get the erase command to use
+     * 
+     * @return No-stretch or extended erase when listed, the legacy erase if that is the only one
+     */
+    Commands eraseCommand() const;
+
+    /**
+     * @brief Send a command byte with its complement and wait for the ACK
+     * 
+     * @param command Command
+     * @return Success
+     */
+    int sendCommand(Commands command);
+
+    /**
+     * @brief CRC of a target memory area calculated by the bootloader (GET_CHECKSUM)
+     * 
+     * @param address Start address
+     * @param len Number of bytes, multiple of 4
+     * @param crc Reference to CRC value
+     * @return Success
+     */
+    int targetCrc(uint32_t address, uint32_t len, uint32_t &crc);
+
+    /**
+     * @brief Calculate CRC32 like the STM32 CRC unit (poly 0x04C11DB7, init 0xFFFFFFFF, 32 bit words)
+     * 
+     * @param bffr Data buffer
+     * @param len Number of bytes, multiple of 4
+     * @return Calculated value
+     */
+    static uint32_t stmCrc32(const uint8_t *bffr, uint32_t len);
+
+    /**
+     * @brief Read the product ID with the GET_ID command
+     * 
+     * @param pid Reference to product ID
+     * @return Success
+     */
+    int getId(uint16_t &pid);
+
+    /**
+     * @brief Build the version cache key of the connected device
+     * 
+     * @param key Reference to key, left empty if the device can't be identified uniquely
+     * @return Success
+     */
+    int getDeviceKey(std::string &key);
+
+    /**
+     * @brief Read target memory in chunks of max 256 bytes
+     * 
+     * @param addr Read address
+     * @param buffer Pointer to buffer
+     * @param len Number of bytes to read
+     * @return Success
+     */
+    int readMemory(uint32_t addr, uint8_t *buffer, uint32_t len);
+
+    /**
+     * @brief Receive an exact number of bytes
+     * 
+     * @param buffer Pointer to buffer
+     * @param len Number of bytes
+     * @return Success
+     */
+    int receiveAll(uint8_t *buffer, int len);
+
+    /**
+     * @brief CRC32 of the selected image
+     * 
+     * @return CRC value
+     */
+    uint32_t imageCrc();
+
+    /**
+     * @brief Load the version cache file
+     */
+    void loadVersionCache();
+
+    /**
+     * @brief Store the current image CRC for the connected device
+     */
+    void storeVersionCache();
+
+    /**
+     * @brief Get the flash ranges of the selected image or binary file, in address order
+     * 
+     * @param regions Reference to output
+     */
+    void imageRegions(std::vector<Region> &regions);
+
+    /**
+     * @brief Find where an interrupted write of the image can continue.
+     * The checkpoint is moved back to the first byte on its erase page, and the block
+     * before that point is compared with the target.
+     * 
+     * @param regions Image regions
+     * @param crc Image CRC
+     * @return Image offset to continue from, 0 to start over
+     */
+    uint32_t resumeOffset(const std::vector<Region> &regions, uint32_t crc);
+
+    /**
+     * @brief Write the image from an offset, storing a checkpoint every CheckpointBlock bytes
+     * 
+     * @param regions Image regions
+     * @param offset Image offset to start from
+     * @param crc Image CRC
+     * @param verbose Verbose output to terminal
+     * @return Success
+     */
+    int writeImage(const std::vector<Region> &regions, uint32_t offset, uint32_t crc, bool verbose);
+
+    /**
+     * @brief Compare a flash range with data, by CRC when the bootloader has GET_CHECKSUM
+     * 
+     * @param address Flash address
+     * @param data Expected content
+     * @param len Number of bytes
+     * @return 1 if equal, 0 if not, negative on communication error
+     */
+    int verifyRange(uint32_t address, const uint8_t *data, uint32_t len);
+
+    /**
+     * @brief Get the erase page (or sector) number of a flash address
+     * 
+     * @param address Flash address
+     * @return Page number
+     */
+    uint32_t pageIndex(uint32_t address) const;
+
+    /**
+     * @brief Load the progress file
+     */
+    void loadCheckpoints();
+
+    /**
+     * @brief Store the write progress for the connected device
+     * 
+     * @param crc Image CRC
+     * @param written Bytes of the image written, 0 removes the entry
+     */
+    void storeCheckpoint(uint32_t crc, uint32_t written);
+
+    /**
+     * @brief Calculate CRC32 (IEEE 802.3)
+     * 
+     * @param bffr Data buffer
+     * @param len Number of bytes
+     * @param crc Previous CRC when calculating in chunks
+     * @return Calculated value
+     */
+    static uint32_t crc32(const uint8_t *bffr, uint32_t len, uint32_t crc=0);
+
+    /**
+     * @brief Erase a range of flash pages with the extended erase page list
+     * 
+     * @param firstPage First page number
+     * @param count Number of pages
+     * @return Success, -2 on timeout
+     */
+    int erase(uint16_t firstPage, uint16_t count);
+
+    /**
+     * @brief Erase the pages covering an address range
+     * 
+     * @param address Start address
+     * @param len Number of bytes
+     * @return Success, -2 on timeout
+     */
+    int eraseRange(uint32_t address, uint32_t len);
+
+    /**
+     * @brief Erase all flash with the selected erase command
+     * 
+     * @return Success, -2 on timeout
+     */
+    int massErase();
+
+    /**
+     * @brief Wait for the ACK of a long running command
+     * 
+     * @param timeoutSec Timeout in seconds
+     * @return Success, -2 on timeout
+     */
+    int waitAck(double timeoutSec);
+
+    /**
+     * @brief programTarget() without the real-time mode handling
+     * 
+     * @param verbose Verbose output to terminal
+     * @return Success
+     */
+    int programSession(bool verbose);
+
+    /**
+     * @brief Flash the selected images of the open smart package in one session
+     * 
+     * @param verbose Verbose output to terminal
+     * @return Success
+     */
+    int programPackage(bool verbose);
+
+    /**
+     * @brief Upload the flash loader to SRAM, start it and switch bitrate
+     * 
+     * @param verbose Verbose output to terminal
+     * @return Success, -1 if the ROM bootloader is still active, -2 if the loader was started but doesn't answer
+     */
+    int startLoader(bool verbose);
+
+    /**
+     * @brief Program the selected images through the flash loader and reset the target
+     * 
+     * @param verbose Verbose output to terminal
+     * @return Success
+     */
+    int programWithLoader(bool verbose);
+
+    /**
+     * @brief Merge regions sharing a page into one erase range each
+     * 
+     * @param regions Flash ranges to be written
+     * @param ranges Reference to the erase ranges (data is nullptr), sorted by address
+     */
+    void eraseRanges(const std::vector<Region> &regions, std::vector<Region> &ranges) const;
+
+    /**
+     * @brief Erase the pages covering all regions through the flash loader, each page once
+     * 
+     * @param regions Flash ranges to be written
+     * @return Success
+     */
+    int loaderErase(const std::vector<Region> &regions);
+
+    /**
+     * @brief Write and verify one erased flash range through the flash loader
+     * 
+     * @param address Flash address
+     * @param data Data
+     * @param len Number of bytes
+     * @return Success
+     */
+    int loaderProgram(uint32_t address, const uint8_t *data, uint32_t len);
+
+    /**
+     * @brief Get the LZ4 compressed form of a block, compressed once per image
+     * 
+     * @param address Flash address of the block
+     * @param data Block data
+     * @param len Block length
+     * @param crc CRC32 of the block
+     * @return Compressed block, empty if it doesn't decode back to the data
+     */
+    const std::vector<uint8_t> &compressedBlock(uint32_t address, const uint8_t *data, uint32_t len, uint32_t crc);
+
+    /**
+     * @brief Send a flash loader request and receive its reply
+     * 
+     * @param command Command
+     * @param payload Request payload (may be nullptr when len is 0)
+     * @param len Payload length
+     * @param reply Reference to reply payload
+     * @param timeoutMs Reply timeout in milli seconds
+     * @return Success, -1 on framing/CRC error, -2 on timeout, -3 if the loader reported an error
+     */
+    int loaderRequest(FlashLoader::Command command, const uint8_t *payload, uint32_t len,
+                      std::vector<uint8_t> &reply, int timeoutMs);
+
+    /**
+     * @brief Receive an exact number of bytes within a time limit
+     * 
+     * @param buffer Pointer to buffer
+     * @param len Number of bytes
+     * @param timeoutMs Timeout in milli seconds
+     * @return Success, -2 on timeout
+     */
+    int receiveTimed(uint8_t *buffer, int len, int timeoutMs);
 
     int write_addr(uint32_t address, uint8_t *buffer, int offset, int length);
 
@@ -171,6 +596,40 @@ class STMBoot : public Serial {
 
     private:
     std::string _bin_file_path;
+    FirmwareImage _image;
+    std::unique_ptr<SmartPackage> _package;
+    std::function<bool(Signature, uint8_t, uint8_t, uint16_t)> _packageFilter;
+    uint32_t _baseAddress;
+    uint32_t _pageSize;
+    bool _pageSizeSet;
+    bool _identified;
+    const STMChip *_chip;
+    uint16_t _pid;
+    uint8_t _bootVersion;
+    std::vector<uint8_t> _commandList;
+    std::string _loaderPath;
+    uint32_t _loaderAddress;
+    int _loaderBitrate;
+    uint32_t _loaderBlock;
+    uint8_t _loaderFeatures;
+    /** @brief Compressed block, valid while length and CRC match the image */
+    struct CompressedBlock {
+        uint32_t length;
+        uint32_t crc;
+        std::vector<uint8_t> data;
+    };
+    std::map<uint32_t, CompressedBlock> _compressedBlocks;
+    std::string _cache_file_path;
+    std::map<std::string, uint32_t> _versionCache;
+    /** @brief Write progress of an image on a device */
+    struct Checkpoint {
+        uint32_t crc;
+        uint32_t written;
+    };
+    std::string _resume_file_path;
+    std::map<std::string, Checkpoint> _checkpoints;
+    std::string _deviceKey;
+    int _priority;
     Header _header;
     uint8_t *_filecontent;
     long _content_size;
@@ -0,0 +1,90 @@
+/**
+ * @file stmchips.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief STM32 chip database keyed by bootloader product ID
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include "stmchips.h"
+
+static const uint32_t K = 1024;
+
+/** @brief Unique ID addresses per family */
+static const uint32_t UidF1 = 0x1FFFF7E8;
+static const uint32_t UidF0F3 = 0x1FFFF7AC;
+static const uint32_t UidF2F4 = 0x1FFF7A10;
+static const uint32_t UidG0G4L4 = 0x1FFF7590;
+
+static const STMChip s_chips[] = {
+    // F0
+    { 0x440, "STM32F030x8/F05x",        64 * K,   1 * K, UidF0F3, false,    8 * K,  2 * K },
+    { 0x444, "STM32F03x",               32 * K,   1 * K, UidF0F3, false,    4 * K,  2 * K },
+    { 0x445, "STM32F04x",               32 * K,   1 * K, UidF0F3, false,    6 * K,  2 * K },
+    { 0x448, "STM32F07x",              128 * K,   2 * K, UidF0F3, false,   16 * K,  6 * K },
+    { 0x442, "STM32F09x",              256 * K,   2 * K, UidF0F3, false,   32 * K,  6 * K },
+    // F1
+    { 0x412, "STM32F10x low density",   32 * K,   1 * K, UidF1,   false,    4 * K,  1 * K },
+    { 0x410, "STM32F10x medium density", 128 * K, 1 * K, UidF1,   false,    8 * K,  1 * K },
+    { 0x414, "STM32F10x high density", 512 * K,   2 * K, UidF1,   false,   32 * K,  1 * K },
+    { 0x430, "STM32F10x XL density",  1024 * K,   2 * K, UidF1,   false,   64 * K,  1 * K },
+    { 0x418, "STM32F105/107",          256 * K,   2 * K, UidF1,   false,   64 * K,  1 * K },
+    { 0x420, "STM32F100 medium density", 128 * K, 1 * K, UidF1,   false,    8 * K,  1 * K },
+    { 0x428, "STM32F100 high density", 512 * K,   2 * K, UidF1,   false,   24 * K,  1 * K },
+    // F2, F4
+    { 0x411, "STM32F2xx",             1024 * K,   0,     UidF2F4, false,   64 * K, 12 * K },
+    { 0x413, "STM32F405/407/415/417", 1024 * K,   0,     UidF2F4, false,  112 * K, 12 * K },
+    { 0x419, "STM32F42x/43x",         2048 * K,   0,     UidF2F4, true,   112 * K, 12 * K },
+    { 0x423, "STM32F401xB/C",          256 * K,   0,     UidF2F4, false,   64 * K, 12 * K },
+    { 0x433, "STM32F401xD/E",          512 * K,   0,     UidF2F4, false,   96 * K, 12 * K },
+    { 0x431, "STM32F411",              512 * K,   0,     UidF2F4, false,  128 * K, 12 * K },
+    { 0x421, "STM32F446",              512 * K,   0,     UidF2F4, false,  112 * K, 12 * K },
+    { 0x434, "STM32F469/479",         2048 * K,   0,     UidF2F4, true,   160 * K, 12 * K },
+    { 0x441, "STM32F412",             1024 * K,   0,     UidF2F4, false,  256 * K, 12 * K },
+    { 0x458, "STM32F410",              128 * K,   0,     UidF2F4, false,   32 * K, 12 * K },
+    { 0x463, "STM32F413/423",         1536 * K,   0,     UidF2F4, false,  256 * K, 12 * K },
+    // F3
+    { 0x422, "STM32F302xB/C/F303xB/C", 256 * K,   2 * K, UidF0F3, false,   32 * K,  6 * K },
+    { 0x432, "STM32F37x",              256 * K,   2 * K, UidF0F3, false,   16 * K,  6 * K },
+    { 0x438, "STM32F303x4/6/8",         64 * K,   2 * K, UidF0F3, false,   12 * K,  6 * K },
+    { 0x439, "STM32F301/302x4/6/8",     64 * K,   2 * K, UidF0F3, false,   16 * K,  6 * K },
+    { 0x446, "STM32F302/303xD/E",      512 * K,   2 * K, UidF0F3, false,   64 * K,  6 * K },
+    // G0, G4, L4
+    { 0x466, "STM32G03x/04x",           64 * K,   2 * K, UidG0G4L4, false,    8 * K,  4 * K },
+    { 0x460, "STM32G07x/08x",          128 * K,   2 * K, UidG0G4L4, false,   32 * K,  4 * K },
+    { 0x468, "STM32G431/441",          128 * K,   2 * K, UidG0G4L4, false,   16 * K, 12 * K },
+    { 0x435, "STM32L43x/44x",          256 * K,   2 * K, UidG0G4L4, false,   48 * K, 12 * K },
+    { 0x462, "STM32L45x/46x",          512 * K,   2 * K, UidG0G4L4, false,  128 * K, 12 * K },
+    { 0x415, "STM32L47x/48x",         1024 * K,   2 * K, UidG0G4L4, false,   96 * K, 12 * K },
+};
+
+const STMChip *STMChip::find(const uint16_t pid){
+    for(const STMChip &n_chip : s_chips) {
+        if(n_chip.pid == pid) return &n_chip;
+    }
+    return nullptr;
+}
+
+uint16_t STMChip::pageOf(const uint32_t offset) const {
+    if(pageSize > 0) return (uint16_t)(offset / pageSize);
+
+    // 4 x 16K, 1 x 64K, then 128K sectors, 12 sectors per bank on dual bank parts
+    uint32_t n_bankSize = dualBank ? flashSize / 2 : flashSize;
+    uint32_t n_bank = offset / n_bankSize;
+    uint32_t n_offset = offset % n_bankSize;
+    uint32_t n_sector = 0;
+    if(n_offset < 64 * K) n_sector = n_offset / (16 * K);
+    else if(n_offset < 128 * K) n_sector = 4;
+    else n_sector = 5 + (n_offset - 128 * K) / (128 * K);
+    return (uint16_t)(n_bank * 12 + n_sector);
+}
+
+int STMChip::pageRange(const uint32_t offset, const uint32_t len, uint16_t &first, uint16_t &count) const {
+    if(len == 0 || offset >= flashSize || len > flashSize - offset) return -1;
+    uint16_t n_last = pageOf(offset + len - 1);
+    first = pageOf(offset);
+    count = (uint16_t)(n_last - first + 1);
+    return 0;
+}
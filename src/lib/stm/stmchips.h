@@ -0,0 +1,64 @@
+/**
+ * @file stmchips.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief STM32 chip database keyed by bootloader product ID
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _STMCHIPS_H_
+#define _STMCHIPS_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Flash geometry of an STM32 line.
+ * Flash size is the largest member of the line, the actual device may be smaller.
+ * F2/F4 lines have sector organised flash (4 x 16K, 64K, then 128K sectors per bank),
+ * they are marked with pageSize 0.
+ * RAM size is the contiguous SRAM at RamBase of the smallest member of the line.
+ */
+struct STMChip {
+    /** @brief Start of SRAM on all lines */
+    static const uint32_t RamBase = 0x20000000;
+
+    uint16_t pid;           // Product ID returned by GET_ID
+    const char *name;       // Line name
+    uint32_t flashSize;     // Flash size in bytes
+    uint32_t pageSize;      // Erase page size in bytes, 0 for sector organised flash
+    uint32_t uidAddress;    // Address of the 96 bit unique device ID, 0 if unknown
+    bool dualBank;          // Sector flash in two banks, sector numbers restart at 12 in bank 2
+    uint32_t ramSize;       // SRAM size in bytes
+    uint32_t bootRam;       // Bytes at RamBase used by the ROM bootloader (AN2606)
+
+    /**
+     * @brief Look up a chip
+     *
+     * @param pid Product ID
+     * @return Pointer to the entry or nullptr if unknown
+     */
+    static const STMChip *find(const uint16_t pid);
+
+    /**
+     * @brief Get the erase pages (or sectors) covering a flash range
+     *
+     * @param offset Offset from the start of flash
+     * @param len Number of bytes
+     * @param first Reference to first page number
+     * @param count Reference to number of pages
+     * @return Success, -1 if the range is outside the flash
+     */
+    int pageRange(const uint32_t offset, const uint32_t len, uint16_t &first, uint16_t &count) const;
+
+    /**
+     * @brief Get the page (or sector) number of a flash offset
+     *
+     * @param offset Offset from the start of flash
+     * @return Page number
+     */
+    uint16_t pageOf(const uint32_t offset) const;
+};
+
+#endif //_STMCHIPS_H_
@@ -0,0 +1,310 @@
+/**
+ * @file portmanager.cpp
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Hot-plug aware serial port manager using kernel/udev uevents
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <poll.h>
+#include <dirent.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#endif
+#include <fstream>
+
+#include "portmanager.h"
+
+#ifndef _WIN32
+/** @brief Multicast group of raw kernel events */
+static const uint32_t KernelGroup = 1;
+/** @brief Multicast group of events re-broadcast by udev */
+static const uint32_t UdevGroup = 2;
+/** @brief Magic in the udev monitor header */
+static const uint32_t UdevMagic = 0xfeedcafe;
+
+/** @brief Header udev puts in front of its events (libudev monitor format) */
+struct UdevHeader {
+    char prefix[8];             // "libudev"
+    uint32_t magic;             // UdevMagic, network byte order
+    uint32_t header_size;
+    uint32_t properties_off;
+    uint32_t properties_len;
+};
+#endif
+
+PortManager::PortManager() : _socket(-1), _udev(false){ }
+
+PortManager::~PortManager(){
+    close();
+}
+
+int PortManager::open(){
+#ifdef _WIN32
+    return -1;
+#else
+    if(_socket >= 0) return 0;
+
+    _socket = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if(_socket < 0) return -1;
+
+    // Sender credentials come with every message, see service()
+    int n_on = 1;
+    if(setsockopt(_socket, SOL_SOCKET, SO_PASSCRED, &n_on, sizeof(n_on)) != 0) {
+        ::close(_socket);
+        _socket = -1;
+        return -1;
+    }
+
+    // Prefer udev events, by the time they are sent the by-id links are in place
+    _udev = (access("/run/udev/control", F_OK) == 0);
+
+    struct sockaddr_nl n_addr;
+    memset(&n_addr, 0, sizeof(n_addr));
+    n_addr.nl_family = AF_NETLINK;
+    n_addr.nl_groups = _udev ? UdevGroup : KernelGroup;
+    if(bind(_socket, (struct sockaddr*)&n_addr, sizeof(n_addr)) != 0) {
+        ::close(_socket);
+        _socket = -1;
+        return -1;
+    }
+    return 0;
+#endif
+}
+
+void PortManager::close(){
+    for(Port &n_port : _ports) detach(n_port);
+#ifndef _WIN32
+    if(_socket >= 0) ::close(_socket);
+#endif
+    _socket = -1;
+}
+
+int PortManager::addPort(const std::string id, Serial *serial, const int baudrate, Callback callback){
+    if(serial == nullptr) return -1;
+    for(const Port &n_port : _ports) {
+        if(n_port.serial == serial) return -1;
+    }
+
+    Port n_port;
+    n_port.id = id;
+    n_port.serial = serial;
+    n_port.baudrate = baudrate;
+    n_port.callback = callback;
+    _ports.push_back(n_port);
+
+    std::string n_devnode = resolve(id);
+    if(n_devnode.empty()) return 0;
+    return (attach(_ports.back(), n_devnode) == 0) ? 1 : 0;
+}
+
+void PortManager::removePort(Serial *serial){
+    for(size_t n_index = 0; n_index < _ports.size(); n_index++) {
+        if(_ports[n_index].serial != serial) continue;
+        detach(_ports[n_index]);
+        _ports.erase(_ports.begin() + n_index);
+        return;
+    }
+}
+
+bool PortManager::isAttached(Serial *serial) const {
+    for(const Port &n_port : _ports) {
+        if(n_port.serial == serial) return !n_port.devnode.empty();
+    }
+    return false;
+}
+
+int PortManager::release(Serial *serial){
+    for(Port &n_port : _ports) {
+        if(n_port.serial != serial) continue;
+        detach(n_port);
+        std::string n_devnode = resolve(n_port.id);
+        if(n_devnode.empty()) return 0;
+        return (attach(n_port, n_devnode) == 0) ? 1 : 0;
+    }
+    return 0;
+}
+
+int PortManager::attach(Port &port, const std::string &devnode){
+    if(port.serial->connect(devnode.c_str(), port.baudrate) != 0) return -1;
+    port.devnode = devnode;
+    if(port.callback) port.callback(devnode, true);
+    return 0;
+}
+
+void PortManager::detach(Port &port){
+    if(port.devnode.empty()) return;
+    port.serial->disconnect();
+    std::string n_devnode = port.devnode;
+    port.devnode.clear();
+    if(port.callback) port.callback(n_devnode, false);
+}
+
+int PortManager::service(const int timeoutMs){
+#ifdef _WIN32
+    return -1;
+#else
+    if(_socket < 0) return -1;
+
+    struct pollfd n_pfd;
+    n_pfd.fd = _socket;
+    n_pfd.events = POLLIN;
+    n_pfd.revents = 0;
+    int n_res = poll(&n_pfd, 1, timeoutMs);
+    if(n_res <= 0) return n_res;
+
+    int n_changed = 0;
+    char n_bffr[8192];
+    char n_control[CMSG_SPACE(sizeof(struct ucred))];
+    while(true) {
+        struct sockaddr_nl n_sender;
+        struct iovec n_iov = { n_bffr, sizeof(n_bffr) - 1 };
+        struct msghdr n_msg;
+        memset(&n_sender, 0, sizeof(n_sender));
+        memset(&n_msg, 0, sizeof(n_msg));
+        n_msg.msg_name = &n_sender;
+        n_msg.msg_namelen = sizeof(n_sender);
+        n_msg.msg_iov = &n_iov;
+        n_msg.msg_iovlen = 1;
+        n_msg.msg_control = n_control;
+        n_msg.msg_controllen = sizeof(n_control);
+
+        ssize_t n_len = recvmsg(_socket, &n_msg, MSG_DONTWAIT);
+        if(n_len <= 0) break;
+        n_bffr[n_len] = 0;
+
+        // As libudev: only multicasts sent by root, kernel events only from the kernel (pid 0).
+        // Any local process can send to the netlink groups.
+        struct cmsghdr *n_cmsg = CMSG_FIRSTHDR(&n_msg);
+        if(n_cmsg == nullptr || n_cmsg->cmsg_type != SCM_CREDENTIALS) continue;
+        struct ucred n_cred;
+        memcpy(&n_cred, CMSG_DATA(n_cmsg), sizeof(n_cred));
+        if(n_cred.uid != 0 || n_sender.nl_groups == 0) continue;
+        if(!_udev && n_sender.nl_pid != 0) continue;
+
+        // Kernel events start with "action@devpath", udev events with a binary header
+        size_t n_pos = 0;
+        if(_udev) {
+            if((size_t)n_len < sizeof(UdevHeader) || strcmp(n_bffr, "libudev") != 0) continue;
+            UdevHeader n_header;
+            memcpy(&n_header, n_bffr, sizeof(n_header));
+            if(ntohl(n_header.magic) != UdevMagic || n_header.properties_off >= (uint32_t)n_len) continue;
+            n_pos = n_header.properties_off;
+        } else {
+            if(strchr(n_bffr, '@') == nullptr) continue;
+            n_pos = strlen(n_bffr) + 1;
+        }
+
+        std::map<std::string, std::string> n_props;
+        while(n_pos < (size_t)n_len) {
+            const char *n_entry = &n_bffr[n_pos];
+            const char *n_sep = strchr(n_entry, '=');
+            if(n_sep != nullptr) n_props[std::string(n_entry, n_sep - n_entry)] = n_sep + 1;
+            n_pos += strlen(n_entry) + 1;
+        }
+        n_changed += handleEvent(n_props);
+    }
+    return n_changed;
+#endif
+}
+
+int PortManager::handleEvent(std::map<std::string, std::string> &props){
+    if(props["SUBSYSTEM"] != "tty") return 0;
+    const std::string &n_action = props["ACTION"];
+    std::string n_devname = props["DEVNAME"];
+    if(n_devname.empty()) return 0;
+    // Kernel events carry the bare name, udev events the full node
+    std::string n_devnode = (n_devname[0] == '/') ? n_devname : "/dev/" + n_devname;
+    n_devname = n_devnode.substr(n_devnode.rfind('/') + 1);
+
+    int n_changed = 0;
+    for(Port &n_port : _ports) {
+        if(n_action == "remove" && n_port.devnode == n_devnode) {
+            detach(n_port);
+            n_changed++;
+        } else if(n_action == "add" && n_port.devnode.empty() && matches(n_port.id, n_devname, props)) {
+            if(attach(n_port, n_devnode) == 0) n_changed++;
+        }
+    }
+    return n_changed;
+}
+
+bool PortManager::matches(const std::string &id, const std::string &devname, std::map<std::string, std::string> &props){
+    if(id == "/dev/" + devname) return true;
+
+    // udev: by-id and by-path links, serial number properties
+    const std::string &n_links = props["DEVLINKS"];
+    size_t n_pos = 0;
+    while(n_pos < n_links.size()) {
+        size_t n_end = n_links.find(' ', n_pos);
+        if(n_end == std::string::npos) n_end = n_links.size();
+        if(n_links.compare(n_pos, n_end - n_pos, id) == 0) return true;
+        n_pos = n_end + 1;
+    }
+    if(!id.empty() && (props["ID_SERIAL_SHORT"] == id || props["ID_SERIAL"] == id)) return true;
+
+    if(!id.empty() && id[0] == '/') {
+#ifndef _WIN32
+        // A link that already exists, or a kernel event without link information
+        char n_real[PATH_MAX];
+        if(realpath(id.c_str(), n_real) != nullptr && std::string(n_real) == "/dev/" + devname) return true;
+#endif
+        return false;
+    }
+    return usbSerial(devname) == id;
+}
+
+std::string PortManager::usbSerial(const std::string &devname){
+#ifdef _WIN32
+    return "";
+#else
+    // Walk from the tty up through the sysfs device tree to the USB device
+    char n_real[PATH_MAX];
+    std::string n_link = "/sys/class/tty/" + devname + "/device";
+    if(realpath(n_link.c_str(), n_real) == nullptr) return "";
+
+    std::string n_path(n_real);
+    while(n_path.size() > strlen("/sys/devices")) {
+        std::ifstream n_file(n_path + "/serial");
+        std::string n_serial;
+        if(n_file.is_open() && std::getline(n_file, n_serial)) return n_serial;
+        n_path.erase(n_path.rfind('/'));
+    }
+    return "";
+#endif
+}
+
+std::string PortManager::resolve(const std::string id){
+#ifdef _WIN32
+    return id;
+#else
+    if(!id.empty() && id[0] == '/') {
+        char n_real[PATH_MAX];
+        if(realpath(id.c_str(), n_real) == nullptr) return "";
+        return n_real;
+    }
+
+    DIR *n_dir = opendir("/sys/class/tty");
+    if(n_dir == nullptr) return "";
+    std::string n_devnode;
+    struct dirent *n_entry;
+    while((n_entry = readdir(n_dir)) != nullptr) {
+        std::string n_name(n_entry->d_name);
+        if(n_name.compare(0, 6, "ttyUSB") != 0 && n_name.compare(0, 6, "ttyACM") != 0) continue;
+        if(usbSerial(n_name) == id) {
+            n_devnode = "/dev/" + n_name;
+            break;
+        }
+    }
+    closedir(n_dir);
+    return n_devnode;
+#endif
+}
@@ -0,0 +1,169 @@
+/**
+ * @file portmanager.h
+ * @author Lars Hederidder (coder@worldwidewhat.dk)
+ * @brief Hot-plug aware serial port manager using kernel/udev uevents
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#ifndef _PORTMANAGER_H_
+#define _PORTMANAGER_H_
+
+#include "serial.h"
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Keeps Serial objects attached to ports identified by a stable name.
+ * A port id is either a device path (/dev/ttyUSB0), a by-id link
+ * (/dev/serial/by-id/usb-FTDI_...) or the USB serial number of the adapter.
+ *
+ * The manager listens to uevents on a netlink socket. When udev is running its
+ * events are used, they arrive after the by-id links exist. Without udev the raw
+ * kernel events are used and the USB serial is looked up in sysfs.
+ * Nothing is polled, service() sleeps in poll() until an event arrives.
+ *
+ * Only available on Linux, open() fails on other platforms.
+ */
+class PortManager {
+    public:
+    /** @brief Called with the device node when a port is attached or detached */
+    typedef std::function<void(const std::string &devnode, bool attached)> Callback;
+
+    public:
+    PortManager();
+    ~PortManager();
+
+    /**
+     * @brief Open the uevent socket
+     *
+     * @return Success
+     */
+    int open();
+
+    /**
+     * @brief Close the uevent socket and disconnect all attached ports
+     */
+    void close();
+
+    /**
+     * @brief Manage a serial object. It is connected right away if the port is present.
+     *
+     * @param id Stable port id
+     * @param serial Serial object, must outlive the manager
+     * @param baudrate Baudrate used when connecting
+     * @param callback Optional attach/detach callback
+     * @return 1 if attached, 0 if waiting for the port and -1 on error
+     */
+    int addPort(const std::string id, Serial *serial, const int baudrate, Callback callback=nullptr);
+
+    /**
+     * @brief Stop managing a serial object, it is disconnected if attached
+     *
+     * @param serial Serial object
+     */
+    void removePort(Serial *serial);
+
+    /**
+     * @brief Check if a managed serial object is connected
+     *
+     * @param serial Serial object
+     * @return Result
+     */
+    bool isAttached(Serial *serial) const;
+
+    /**
+     * @brief Disconnect after a communication error. If the port is still present it
+     * is reopened right away, otherwise it is attached again on the next add event.
+     *
+     * @param serial Serial object
+     * @return 1 if attached again, 0 if waiting for the port
+     */
+    int release(Serial *serial);
+
+    /**
+     * @brief Wait for and handle uevents
+     *
+     * @param timeoutMs Max time to wait, -1 waits forever
+     * @return Number of ports attached or detached, -1 on error
+     */
+    int service(const int timeoutMs);
+
+    /**
+     * @brief Get the socket, for use in an external poll loop
+     *
+     * @return File descriptor or -1
+     */
+    int fileDescriptor() const { return _socket; }
+
+    /**
+     * @brief Find the current device node of a port id
+     *
+     * @param id Stable port id
+     * @return Device node or empty string
+     */
+    static std::string resolve(const std::string id);
+
+    private:
+    /** @brief Managed port */
+    struct Port {
+        std::string id;
+        Serial *serial;
+        int baudrate;
+        Callback callback;
+        std::string devnode;    // Empty while detached
+    };
+
+    /**
+     * @brief Handle one uevent
+     *
+     * @param props Event properties
+     * @return Number of ports attached or detached
+     */
+    int handleEvent(std::map<std::string, std::string> &props);
+
+    /**
+     * @brief Check if a tty device matches a port id
+     *
+     * @param id Stable port id
+     * @param devname Kernel device name (ttyUSB0)
+     * @param props Event properties, may be empty
+     * @return Result
+     */
+    static bool matches(const std::string &id, const std::string &devname, std::map<std::string, std::string> &props);
+
+    /**
+     * @brief Read the USB serial number of a tty device from sysfs
+     *
+     * @param devname Kernel device name
+     * @return Serial number or empty string
+     */
+    static std::string usbSerial(const std::string &devname);
+
+    /**
+     * @brief Connect a port
+     *
+     * @param port Port
+     * @param devnode Device node
+     * @return Success
+     */
+    int attach(Port &port, const std::string &devnode);
+
+    /**
+     * @brief Disconnect a port
+     *
+     * @param port Port
+     */
+    void detach(Port &port);
+
+    private:
+    int _socket;
+    bool _udev;
+    std::vector<Port> _ports;
+};
+
+#endif //_PORTMANAGER_H_
@@ -22,6 +22,7 @@
 // Linux specific includes.
 #include <termios.h>
 #include <sys/ioctl.h>
+#include <poll.h>
 #endif
 
 #include <fcntl.h>
@@ -124,6 +125,38 @@ int Serial::disconnect(){
     return 0;
 }
 
+int Serial::setBitrate(const int bitsPerSecond){
+#ifdef _WIN32
+    DCB n_dcbSerialParameters;
+    if(!GetCommState(_fd, &n_dcbSerialParameters)) return -1;
+    n_dcbSerialParameters.BaudRate = bitsPerSecond;
+    return SetCommState(_fd, &n_dcbSerialParameters) ? 0 : -1;
+#else
+    speed_t n_speed;
+    switch (bitsPerSecond)
+    {
+    case 9600:      n_speed = B9600; break;
+    case 19200:     n_speed = B19200; break;
+    case 38400:     n_speed = B38400; break;
+    case 57600:     n_speed = B57600; break;
+    case 115200:    n_speed = B115200; break;
+    case 230400:    n_speed = B230400; break;
+    case 460800:    n_speed = B460800; break;
+    case 921600:    n_speed = B921600; break;
+    case 1000000:   n_speed = B1000000; break;
+    case 2000000:   n_speed = B2000000; break;
+    case 3000000:   n_speed = B3000000; break;
+    default:        return -1;
+    }
+
+    struct termios n_tio;
+    if(tcgetattr(_fd, &n_tio) != 0) return -1;
+    cfsetispeed(&n_tio, n_speed);
+    cfsetospeed(&n_tio, n_speed);
+    return (tcsetattr(_fd, TCSADRAIN, &n_tio) == 0) ? 0 : -1;
+#endif
+}
+
 int Serial::set_rts(bool state){
 #ifdef _WIN32
     return EscapeCommFunction(_fd, state ? SETRTS : CLRRTS) ? 0 : -1;
@@ -142,6 +175,45 @@ int Serial::set_dtr(bool state){
 #endif    
 }
 
+int Serial::available(){
+#ifdef _WIN32
+    if(!ClearCommError(_fd, (LPDWORD)&_errors, (LPCOMSTAT)&_status)) return -1;
+    return (int)_status.cbInQue;
+#else
+    int n_bytes = 0;
+    if(ioctl(_fd, FIONREAD, &n_bytes) != 0) return -1;
+    return n_bytes;
+#endif
+}
+
+int Serial::flushInput(){
+#ifdef _WIN32
+    return PurgeComm(_fd, PURGE_RXCLEAR) ? 0 : -1;
+#else
+    return (tcflush(_fd, TCIFLUSH) == 0) ? 0 : -1;
+#endif
+}
+
+int Serial::waitReadable(int timeoutMs){
+#ifdef _WIN32
+    for(int n_waited = 0; ; n_waited++) {
+        int n_avail = available();
+        if(n_avail != 0) return (n_avail > 0) ? 1 : -1;
+        if(n_waited >= timeoutMs) return 0;
+        Sleep(1);
+    }
+#else
+    struct pollfd n_pfd;
+    n_pfd.fd = _fd;
+    n_pfd.events = POLLIN;
+    n_pfd.revents = 0;
+    int n_res = poll(&n_pfd, 1, timeoutMs);
+    if(n_res < 0) return (errno == EINTR) ? 0 : -1;
+    if(n_res == 0) return 0;
+    return (n_pfd.revents & POLLIN) ? 1 : -1;
+#endif
+}
+
 int Serial::receive(uint8_t * buffer, int len, int offset){
     buffer+=offset;
 #ifdef _WIN32    
@@ -175,8 +247,31 @@ int Serial::transmit(uint8_t * buffer, int len, int offset){
 #else    
     
     ssize_t n_byteswritten = write(_fd, buffer, len);
-    tcflush(_fd, TCOFLUSH);
+    tcdrain(_fd);
 #endif    
     return (int)n_byteswritten;
 }
 
+int Serial::transmitAll(const uint8_t *buffer, int len){
+#ifdef _WIN32
+    DWORD n_byteswritten = 0;
+    if(!WriteFile(_fd, (const void*)buffer, len, &n_byteswritten, 0)){
+        ClearCommError(_fd, (LPDWORD)&_errors, (LPCOMSTAT)&_status);
+        return 0;
+    }
+    FlushFileBuffers(_fd);
+    return (int)n_byteswritten;
+#else
+    int n_written = 0;
+    while(n_written < len) {
+        ssize_t n_res = write(_fd, buffer + n_written, len - n_written);
+        if(n_res < 0) {
+            if(errno == EINTR) continue;
+            break;
+        }
+        n_written += (int)n_res;
+    }
+    tcdrain(_fd);
+    return n_written;
+#endif
+}
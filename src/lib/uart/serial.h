@@ -49,6 +49,14 @@ class Serial {
      */
     int disconnect();
 
+    /**
+     * @brief Change the bitrate of the open port, other settings are kept
+     * 
+     * @param bitsPerSecond Bitrate in bits per second (ie. 921600)
+     * @return Success, -1 if the rate isn't supported
+     */
+    int setBitrate(const int bitsPerSecond);
+
     /**
      * @brief Set the rts pin
      * 
@@ -64,6 +72,37 @@ class Serial {
      * @return Success
      */
     int set_dtr(bool state);
+
+    /**
+     * @brief Get the number of bytes waiting in the receive buffer
+     * 
+     * @return Number of bytes available or -1 on error
+     */
+    int available();
+
+    /**
+     * @brief Wait until data is ready to be read
+     * 
+     * @param timeoutMs Max time to wait in milli seconds
+     * @return 1 if data is ready, 0 on timeout and -1 on error
+     */
+    int waitReadable(int timeoutMs);
+
+    /**
+     * @brief Drop everything waiting in the receive buffer, including the driver queue
+     * 
+     * @return Success
+     */
+    int flushInput();
+
+#ifndef _WIN32
+    /**
+     * @brief Get the file descriptor of the open device
+     * 
+     * @return File descriptor
+     */
+    int fileDescriptor() const { return _fd; }
+#endif
     protected:
 
     /**
@@ -77,7 +116,7 @@ class Serial {
     int receive(uint8_t * buffer, int len, int offset=0);
 
     /**
-     * @brief Transmit data to the device
+     * @brief Transmit data to the device and wait until it has left the port
      * 
      * @param buffer Pointer to output buffer
      * @param len Number of bytes to transmit
@@ -86,6 +125,17 @@ class Serial {
      */
     int transmit(uint8_t* buffer, int len, int offset=0);
 
+    /**
+     * @brief Transmit a block and wait until it has left the port.
+     * Unlike transmit() short writes are continued, for blocks larger than the
+     * driver buffer.
+     * 
+     * @param buffer Pointer to output buffer
+     * @param len Number of bytes to transmit
+     * @return Number of bytes written
+     */
+    int transmitAll(const uint8_t* buffer, int len);
+
 #ifdef _WIN32
     /**
      * @brief Sleep usleep isn't a part the the windows standard lib.
@@ -1,31 +1,53 @@
 #define CCTALK
 
 #include <iostream>
-//#include <unistd.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 #include <string>
 #include "lib/stm/stmboot.h"
 
 #ifdef CCTALK
 #include "lib/cctalk/cctalk.h"
+#include "lib/cctalk/cctalkscheduler.h"
+#ifndef _WIN32
+#include "lib/uart/portmanager.h"
+#endif
 
 CCTalk cct(1);
 CCTalk::EventStack eventStack;
+CCTalkPollScheduler scheduler;
+const uint8_t validatorAddress = 2;
 
 int n_response_cnt = 0;
 
 void runComm(){
 	bool n_connected = false;
 	std::printf("Connect CCT\n");
+	scheduler.addDevice(validatorAddress);
+	scheduler.queryPollPriority(cct, validatorAddress);
 	while (true)
 	{
-		int n_diff = cct.getEventStack(2, eventStack);
+		// Fast while coins arrive, slower when idle
+		uint8_t n_address = validatorAddress;
+		int n_wait = scheduler.next(n_address);
+		if(n_wait > 0) {
+#ifdef _WIN32
+			Sleep(n_wait);
+#else
+			usleep(n_wait * 1000);
+#endif
+		}
+
+		int n_diff = cct.getEventStack(n_address, eventStack);
+		if(n_diff >= 0) scheduler.update(n_address, n_diff, eventStack.lost);
+		if(eventStack.lost > 0) std::printf("Event buffer overflow, %d events lost\n", eventStack.lost);
 
 		if(n_diff < 0) {
 			n_response_cnt = 0;
 			std::printf("ERROR!!!!!\r");
 			std::fflush(stdout);
-			cct.disconnect();
 			break;
 		} else if (!n_connected)
 		{
@@ -48,11 +70,6 @@ void runComm(){
 					eventStack.events[m_index].event_Value);
 			}
 		}
-#ifdef _WIN32
-		Sleep(100);
-#else		
-		usleep(100000);
-#endif		
 	}
 }
 
@@ -77,21 +94,15 @@ int main(int argc, char *argv[])
 	std::printf("Welcome\n");
 	std::printf("argc: %d\n", argc);
 
-	Host n_host;
-	if(n_host.connect(hostPort.c_str(), B115200) != 0){
-		std::printf("Unable to connect to port\n");
-		return 0;
-	}
-	
-	if(n_host.reboot() != 0){
-		std::printf("Turn on device\n");
-	}
-	n_host.disconnect();
+	// init() keeps sending the sync byte for 10 seconds
+	std::printf("Turn on device in bootloader mode\n");
 
 	STMBoot n_boot;
 	STMBoot::Header n_header;
 	//std::string str();
 	n_boot.setProgressCallback(progress);
+	n_boot.setVersionCache("flashed_devices.txt");
+	n_boot.setResumeFile("flash_progress.txt");
 
 	if(n_boot.connect(hostPort.c_str(), B115200) == 0) {
 		n_boot.setBinaryFile("controller_app.bin");
@@ -107,12 +118,15 @@ int main(int argc, char *argv[])
 														n_header.minor,
 														n_header.build);
 
-		if(n_boot.init(STMBoot::Target::ControllerFW) != 0) {
+		if(n_boot.init(STMBoot::Target::STM32_NATIVE) != 0) {
 			std::printf("Unable to init device\n");
 		} else {
 			std::printf("Device connected\n");
-			n_res = n_boot.programTarget(true);
-			if(n_res != 0) {
+			n_res = n_boot.isTargetCurrent();
+			if(n_res == 1) {
+				std::printf("Target already up to date\n");
+				n_boot.disconnect();
+			} else if((n_res = n_boot.programTarget(true)) != 0) {
 				std::printf("Error while programming target\n");
 			} else {
 				std::printf("Target programmed OK\n");
@@ -123,7 +137,27 @@ int main(int argc, char *argv[])
 
 
 #ifdef CCTALK	
-	
+
+#ifndef _WIN32
+	// Attach on hot-plug instead of retrying the port. cctPort may also be a
+	// /dev/serial/by-id link or the USB serial number of the adapter.
+	PortManager n_ports;
+	if(n_ports.open() == 0) {
+		n_ports.addPort(cctPort, &cct, B9600, [](const std::string &devnode, bool attached){
+			std::printf("%s %s\n", devnode.c_str(), attached ? "attached" : "detached");
+		});
+
+		while(true) {
+			if(n_ports.isAttached(&cct)) {
+				runComm();
+				n_ports.release(&cct);
+			}
+			// Don't spin if the event socket fails
+			if(n_ports.service(1000) < 0) usleep(1000000);
+		}
+	}
+	std::printf("Unable to watch for port changes, retrying the port instead\n");
+#endif
 	while(true) {
 		
 		if(cct.connect(cctPort.c_str(), B9600) != 0){
@@ -136,6 +170,7 @@ int main(int argc, char *argv[])
 #endif			
 		} else {
 			runComm();
+			cct.disconnect();
 		}
 	}
 #endif	